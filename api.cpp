@@ -1,19 +1,27 @@
 #include "api.h"
+#include "geodesy.h"
+#include "log.h"
 #include "parson/parson.h"
+#include "ringbuffer.h"
 
 #include <curl/curl.h>
+#include <map>
 #include <math.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <string>
 #include <string.h>
 #include <unistd.h>
 
 // define maximum viewing distance in nautical miles
-#define MAX_DISTANCE 20.0
+#define MAX_DISTANCE 40.0
 
 // define intervall in seconds after which a plane is removed if there is no more data about it
 #define PLANE_TIMEOUT 30
 
+// define number of one second buckets of the expiry timing wheel, must be larger than PLANE_TIMEOUT
+#define EXPIRY_WHEEL_SIZE 64
+
 // define URLs
 #define URL_BALANCE "http://www.flightradar24.com/balance.json"
 #define URL_ZONES "http://www.flightradar24.com/js/zones.js.php"
@@ -21,6 +29,7 @@
 #define URL_ZONE_SUFFIX "_all.json"
 
 // define indices of relevant aircraft properties for parsing
+#define ARRAY_INDEX_MODE_S_ADDRESS 0
 #define ARRAY_INDEX_LATITUDE 1
 #define ARRAY_INDEX_LONGITUDE 2
 #define ARRAY_INDEX_HEADING 3
@@ -29,17 +38,37 @@
 #define ARRAY_INDEX_SQUAWK 6
 #define ARRAY_INDEX_ICAO_TYPE 8
 #define ARRAY_INDEX_REGISTRATION 9
+#define ARRAY_INDEX_TIMESTAMP 10
 #define ARRAY_INDEX_VERTICAL_SPEED 15
 #define ARRAY_INDEX_ICAO_ID 16
 
-// define radius of the earth in nautical miles
-#define RADIUS_EARTH 3440.07
+// define number of aircraft of a zone whose positions are filtered by their distance in one batch
+#define DISTANCE_BATCH_SIZE 256
+
+// define number of deltas the queue to the sim thread can hold, must be a power of two
+#define DELTA_QUEUE_SIZE 4096
 
-// external variables
-std::map<std::string, Plane*> planes;
-pthread_mutex_t planesMutex;
+// define all delta field flags
+#define DELTA_FIELDS_ALL (DELTA_FIELD_POSITION | DELTA_FIELD_ALTITUDE | DELTA_FIELD_HEADING | DELTA_FIELD_SPEED | DELTA_FIELD_VERTICAL_SPEED | DELTA_FIELD_IDENTITY)
+
+// define tracked plane struct, the update thread's view of a plane that has been sent to the sim thread
+struct TrackedPlane
+{
+    unsigned short slot; // slot of the plane on the sim thread
+    Plane plane; // last reported values
+};
 
 // global variables
+static std::map<std::string, TrackedPlane> trackedPlanes; // only accessed by the update thread
+static unsigned short freeSlots[MAX_TRACKED_PLANES]; // queue of the unused slots, a freed slot is reused last so that the sim thread has long forgotten its previous plane, only accessed by the update thread
+static int freeSlotStart = 0, freeSlotCount = 0;
+static int droppedPlanes = 0; // number of new planes of the current zone update that could not be tracked because all slots are in use
+static std::map<std::string, TrackedPlane>::iterator slotPlanes[MAX_TRACKED_PLANES]; // tracked plane of each used slot, only accessed by the update thread
+static time_t expiryDeadlines[MAX_TRACKED_PLANES]; // time at which the plane in each slot expires
+static int expiryNext[MAX_TRACKED_PLANES], expiryPrevious[MAX_TRACKED_PLANES]; // links of the timing wheel bucket lists, -1 terminates a list
+static int expiryBuckets[EXPIRY_WHEEL_SIZE]; // first slot of each timing wheel bucket, -1 if the bucket is empty
+static time_t expiryTime = 0; // time up to which all timing wheel buckets have been processed
+static RingBuffer<Delta, DELTA_QUEUE_SIZE> deltaQueue;
 static char *lastZone = NULL;
 static double userLatitude = 48.3537449, userLongitude = 11.7860028; // Munich
 //static double latitude = 0.0, longitude = 0.0;
@@ -54,6 +83,8 @@ static double userLatitude = 48.3537449, userLongitude = 11.7860028; // Munich
 //static double userLatitude = 47.4812134, userLongitude = 19.1303031; // Budapest
 static pthread_t thread = 0;
 static pthread_mutex_t positionMutex;
+static double batchLatitudes[DISTANCE_BATCH_SIZE], batchLongitudes[DISTANCE_BATCH_SIZE]; // only accessed by the update thread
+static unsigned char batchWithinDistance[DISTANCE_BATCH_SIZE]; // only accessed by the update thread
 
 // define UrlData struct used by libcurl
 struct UrlData
@@ -136,6 +167,15 @@ struct json_value_t
     JSON_Value_Value value;
 };
 
+// define json_object_t struct used by Parson
+struct json_object_t
+{
+    char **names;
+    JSON_Value **values;
+    size_t count;
+    size_t capacity;
+};
+
 // retrieves the balancer url with the lowest load, if there are several balancers with the same load one of these is randomly selected
 static char *GetBalancerUrl(void)
 {
@@ -193,42 +233,6 @@ static char *GetBalancerUrl(void)
     return bestUrl;
 }
 
-// converts from degrees to radians
-inline static double DegreesToRadians(double degrees)
-{
-    return degrees * (M_PI / 180.0);
-}
-
-// converts from degrees to radians
-inline static double RadiansToDegrees(double radians)
-{
-    return radians * (180.0 / M_PI);
-}
-
-// calculates the midpoint between two given coordinates
-static void GetMidpoint(double *latitudeMidpoint, double *longitudeMidpoint, double latiudeA, double longitudeA, double latiudeB, double longitudeB)
-{
-    double dLongitude = DegreesToRadians(longitudeB - longitudeA);
-    double bX = cos(DegreesToRadians(latiudeB)) * cos(dLongitude);
-    double bY = cos(DegreesToRadians(latiudeB)) * sin(dLongitude);
-
-    *latitudeMidpoint = RadiansToDegrees(atan2(sin(DegreesToRadians(latiudeA)) + sin(DegreesToRadians(latiudeB)), sqrt((cos(DegreesToRadians(latiudeA)) + bX) * (cos(DegreesToRadians(latiudeA)) + bX) + bY * bY)));
-
-    *longitudeMidpoint = longitudeA + RadiansToDegrees(atan2(bY, cos(DegreesToRadians(latiudeA)) + bX));
-}
-
-// calculates the distance between two coordinates in nautical miles
-static double GetDistance(double latiudeA, double longitudeA, double latiudeB, double longitudeB)
-{
-    double dLatitude = latiudeB - latiudeA;
-    double dLongitude = longitudeB - longitudeA;
-
-    double a = pow(sin(DegreesToRadians(dLatitude / 2.0)), 2) + cos(DegreesToRadians(latiudeA)) * cos(DegreesToRadians(latiudeB)) * pow(sin(DegreesToRadians(dLongitude / 2.0)), 2);
-    double c = 2.0 * atan2(sqrt(a), sqrt(1.0 - a));
-
-    return c * RADIUS_EARTH;
-}
-
 // parses a JSON object containing zones and calculates the zone that fits the given latitude and longitude best, bestDistance is used internally and contains the distance from the midpoint of the selected zone
 static void ParseZones(char **bestZone, double *bestDistance, JSON_Object *zonesJson, double latitude, double longitude)
 {
@@ -344,26 +348,189 @@ static char *GetZoneName(double latitude, double longitude)
     return zoneName;
 }
 
-// updates the planes map, planes not seen for a defined intervall are removed from the map and only planes within a defined distance from the given latitude and longited
-static void UpdatePlanes(char *balancerUrl, char *zoneName, double latitude, double longitude)
+// appends a delta to the queue, if the sim thread has not caught up yet the update thread waits for free space, deltas are never dropped because the sim thread would lose track of the planes, the sim thread frees up to a full queue per flight loop so a burst waits for one flight loop per DELTA_QUEUE_SIZE deltas beyond the first, usleep is a cancellation point so Cleanup can still stop a waiting update thread
+static void PushDelta(const Delta *delta)
 {
-    time_t currentTime = time(NULL);
+    while (!deltaQueue.Push(*delta))
+        usleep(1000);
+}
 
-    if (currentTime != ((time_t) -1))
+// removes a slot from its timing wheel bucket
+static void UnscheduleExpiry(int slot)
+{
+    if (expiryPrevious[slot] != -1)
+        expiryNext[expiryPrevious[slot]] = expiryNext[slot];
+    else
+        expiryBuckets[expiryDeadlines[slot] % EXPIRY_WHEEL_SIZE] = expiryNext[slot];
+
+    if (expiryNext[slot] != -1)
+        expiryPrevious[expiryNext[slot]] = expiryPrevious[slot];
+}
+
+// inserts a slot into the timing wheel bucket of the given deadline
+static void ScheduleExpiry(int slot, time_t deadline)
+{
+    int bucket = deadline % EXPIRY_WHEEL_SIZE;
+
+    expiryDeadlines[slot] = deadline;
+    expiryPrevious[slot] = -1;
+    expiryNext[slot] = expiryBuckets[bucket];
+    if (expiryBuckets[bucket] != -1)
+        expiryPrevious[expiryBuckets[bucket]] = slot;
+    expiryBuckets[bucket] = slot;
+}
+
+// sends the difference between a new report and the last known state of a plane to the sim thread, starts tracking the plane if it is new
+static void UpdateTrackedPlane(const char *id, const Plane *report)
+{
+    Delta delta;
+    delta.fields = 0;
+
+    std::map<std::string, TrackedPlane>::iterator t = trackedPlanes.find(id);
+    if (t == trackedPlanes.end())
     {
-        pthread_mutex_lock(&planesMutex);
-        for (std::map<std::string, Plane*>::iterator p = planes.begin(); p != planes.end(); ++p)
+        if (freeSlotCount == 0)
         {
-            Plane *plane = p->second;
-            if (currentTime - plane->lastSeen > PLANE_TIMEOUT)
+            droppedPlanes++;
+            return;
+        }
+
+        TrackedPlane trackedPlane;
+        trackedPlane.slot = freeSlots[freeSlotStart];
+        freeSlotStart = (freeSlotStart + 1) % MAX_TRACKED_PLANES;
+        freeSlotCount--;
+        trackedPlane.plane = *report;
+        t = trackedPlanes.insert(std::make_pair(std::string(id), trackedPlane)).first;
+        slotPlanes[trackedPlane.slot] = t;
+
+        delta.type = DELTA_ADD;
+        delta.fields = DELTA_FIELDS_ALL;
+    }
+    else
+    {
+        Plane *plane = &t->second.plane;
+        UnscheduleExpiry(t->second.slot);
+
+        delta.type = DELTA_UPDATE;
+        if (plane->latitude != report->latitude || plane->longitude != report->longitude)
+            delta.fields |= DELTA_FIELD_POSITION;
+        if (plane->altitude != report->altitude)
+            delta.fields |= DELTA_FIELD_ALTITUDE;
+        if (plane->heading != report->heading)
+            delta.fields |= DELTA_FIELD_HEADING;
+        if (plane->speed != report->speed)
+            delta.fields |= DELTA_FIELD_SPEED;
+        if (plane->verticalSpeed != report->verticalSpeed)
+            delta.fields |= DELTA_FIELD_VERTICAL_SPEED;
+        if (strcmp(plane->registration, report->registration) != 0 || strcmp(plane->icaoId, report->icaoId) != 0 || strcmp(plane->icaoType, report->icaoType) != 0 || strcmp(plane->squawk, report->squawk) != 0 || plane->modeSAddress != report->modeSAddress)
+            delta.fields |= DELTA_FIELD_IDENTITY;
+
+        *plane = *report;
+    }
+
+    ScheduleExpiry(t->second.slot, report->lastSeen + PLANE_TIMEOUT + 1);
+
+    if (delta.fields == 0)
+        return;
+
+    delta.slot = t->second.slot;
+    delta.heading = report->heading;
+    delta.speed = report->speed;
+    delta.verticalSpeed = report->verticalSpeed;
+    delta.latitude = report->latitude;
+    delta.longitude = report->longitude;
+    delta.altitude = report->altitude;
+    delta.timestamp = (double) report->timestamp;
+    memcpy(delta.registration, report->registration, sizeof(delta.registration));
+    memcpy(delta.icaoId, report->icaoId, sizeof(delta.icaoId));
+    memcpy(delta.icaoType, report->icaoType, sizeof(delta.icaoType));
+    memcpy(delta.squawk, report->squawk, sizeof(delta.squawk));
+    delta.modeSAddress = report->modeSAddress;
+
+    PushDelta(&delta);
+}
+
+// returns the 24 bit ICAO address of a plane from its reported hexadecimal address, if it is missing or invalid a nonzero address is derived from the feed's key of the plane
+static unsigned int GetModeSAddress(const char *address, const char *id)
+{
+    if (address != NULL && address[0] != '\0')
+    {
+        char *end = NULL;
+        unsigned long value = strtoul(address, &end, 16);
+        if (*end == '\0' && value > 0 && value <= 0xFFFFFF)
+            return (unsigned int) value;
+    }
+
+    // FNV-1a hash of the key folded to 24 bits
+    unsigned int hash = 2166136261u;
+    for (const char *c = id; *c != '\0'; c++)
+        hash = (hash ^ (unsigned char) *c) * 16777619u;
+    hash = (hash >> 24 ^ hash) & 0xFFFFFF;
+
+    return hash != 0 ? hash : 1;
+}
+
+// stops tracking a plane and tells the sim thread to remove it
+static void RemoveTrackedPlane(std::map<std::string, TrackedPlane>::iterator t)
+{
+    Delta delta;
+    delta.slot = t->second.slot;
+    delta.type = DELTA_REMOVE;
+    delta.fields = 0;
+    PushDelta(&delta);
+
+    UnscheduleExpiry(t->second.slot);
+    freeSlots[(freeSlotStart + freeSlotCount++) % MAX_TRACKED_PLANES] = t->second.slot;
+    trackedPlanes.erase(t);
+}
+
+// removes all planes whose expiry deadline has passed, only the timing wheel buckets between the last call and the given time are visited
+static void ExpirePlanes(time_t currentTime)
+{
+    if (currentTime - expiryTime > EXPIRY_WHEEL_SIZE)
+        expiryTime = currentTime - EXPIRY_WHEEL_SIZE;
+
+    for (; expiryTime < currentTime; expiryTime++)
+    {
+        int slot = expiryBuckets[(expiryTime + 1) % EXPIRY_WHEEL_SIZE];
+        while (slot != -1)
+        {
+            int next = expiryNext[slot];
+
+            if (expiryDeadlines[slot] <= currentTime)
             {
-                //printf("Removing: %s - CurrentTime = %d - LastSeen = %d\n", p->first.c_str(), (int) currentTime, (int) plane->lastSeen);
-                free(plane);
-                plane = NULL;
-                planes.erase(p->first);
+                //printf("Removing: %s - CurrentTime = %d - LastSeen = %d\n", slotPlanes[slot]->first.c_str(), (int) currentTime, (int) slotPlanes[slot]->second.plane.lastSeen);
+                RemoveTrackedPlane(slotPlanes[slot]);
             }
+
+            slot = next;
         }
-        pthread_mutex_unlock(&planesMutex);
+    }
+}
+
+// filters the positions of a batch of aircraft of a zone by their distance before their other properties are parsed, aircraft without a valid position are placed at 0/0 and rejected when they are parsed
+static void FilterAircraftBatch(JSON_Object *aircraftJson, size_t first, size_t count, const DistanceFilter *filter)
+{
+    for (size_t b = 0; b < count; b++)
+    {
+        JSON_Value *value = aircraftJson->values[first + b];
+        JSON_Array *propertiesJson = value != NULL && value->type == JSONArray ? json_value_get_array(value) : NULL;
+
+        batchLatitudes[b] = propertiesJson != NULL ? json_array_get_number(propertiesJson, ARRAY_INDEX_LATITUDE) : 0.0;
+        batchLongitudes[b] = propertiesJson != NULL ? json_array_get_number(propertiesJson, ARRAY_INDEX_LONGITUDE) : 0.0;
+    }
+
+    FilterWithinDistance(filter, batchLatitudes, batchLongitudes, (int) count, batchWithinDistance);
+}
+
+// updates the planes map, planes not seen for a defined intervall are removed from the map and only planes within a defined distance from the given latitude and longited
+static void UpdatePlanes(char *balancerUrl, char *zoneName, double latitude, double longitude)
+{
+    time_t currentTime = time(NULL);
+
+    if (currentTime != ((time_t) -1))
+    {
+        ExpirePlanes(currentTime);
 
         char url[strlen(balancerUrl) + strlen(URL_ZONE_INFIX) + strlen(zoneName) + strlen(URL_ZONE_SUFFIX)];
         sprintf(url, "%s%s%s%s", balancerUrl, URL_ZONE_INFIX, zoneName, URL_ZONE_SUFFIX);
@@ -387,13 +554,22 @@ static void UpdatePlanes(char *balancerUrl, char *zoneName, double latitude, dou
                         JSON_Object *aircraftJson = json_value_get_object(rootJson);
                         if (aircraftJson != NULL)
                         {
+                            DistanceFilter filter;
+                            InitDistanceFilter(&filter, latitude, longitude, MAX_DISTANCE);
+
                             size_t aircraftCount = json_object_get_count(aircraftJson);
                             for (int i = 0; i < aircraftCount; i++)
                             {
+                                // most aircraft of a zone are too far away, their distance is checked in batches before anything else is parsed
+                                if (i % DISTANCE_BATCH_SIZE == 0)
+                                    FilterAircraftBatch(aircraftJson, i, aircraftCount - i < DISTANCE_BATCH_SIZE ? aircraftCount - i : DISTANCE_BATCH_SIZE, &filter);
+                                if (!batchWithinDistance[i % DISTANCE_BATCH_SIZE])
+                                    continue;
+
                                 const char *id = json_object_get_name(aircraftJson, i);
                                 if (id != NULL)
                                 {
-                                    JSON_Value *value = json_object_get_value(aircraftJson, id);
+                                    JSON_Value *value = aircraftJson->values[i];
 
                                     if (value != NULL && value->type == JSONArray)
                                     {
@@ -401,10 +577,11 @@ static void UpdatePlanes(char *balancerUrl, char *zoneName, double latitude, dou
 
                                         if (propertiesJson != NULL)
                                         {
-                                            const char *registration = NULL, *icaoId = NULL, *icaoType = NULL, *squawk = NULL;
+                                            const char *registration = NULL, *icaoId = NULL, *icaoType = NULL, *squawk = NULL, *modeSAddress = NULL;
                                             double latitudePlane = 0.0, longitudePlane = 0.0, altitude = 0.0;
                                             float heading = 0.0f;
                                             int speed = 0, verticalSpeed = 0;
+                                            time_t timestamp = 0;
 
                                             int propertyCount = json_array_get_count(propertiesJson);
                                             for (int k = 0; k < propertyCount; k++)
@@ -415,6 +592,9 @@ static void UpdatePlanes(char *balancerUrl, char *zoneName, double latitude, dou
                                                 {
                                                     switch (k)
                                                     {
+                                                    case ARRAY_INDEX_MODE_S_ADDRESS:
+                                                        modeSAddress = json_value_get_string(valueJson);
+                                                        break;
                                                     case ARRAY_INDEX_LATITUDE:
                                                         latitudePlane = json_value_get_number(valueJson);
                                                         break;
@@ -439,6 +619,9 @@ static void UpdatePlanes(char *balancerUrl, char *zoneName, double latitude, dou
                                                     case ARRAY_INDEX_REGISTRATION:
                                                         registration = json_value_get_string(valueJson);
                                                         break;
+                                                    case ARRAY_INDEX_TIMESTAMP:
+                                                        timestamp = (time_t) json_value_get_number(valueJson);
+                                                        break;
                                                     case ARRAY_INDEX_VERTICAL_SPEED:
                                                         verticalSpeed = (int) json_value_get_number(valueJson);
                                                         break;
@@ -449,63 +632,47 @@ static void UpdatePlanes(char *balancerUrl, char *zoneName, double latitude, dou
                                                 }
                                             }
 
-                                            if (latitudePlane != 0.0 && longitudePlane != 0.0 && GetDistance(latitude, longitude, latitudePlane, longitudePlane) <= MAX_DISTANCE)
+                                            if (latitudePlane != 0.0 && longitudePlane != 0.0)
                                             {
-                                                Plane *plane = NULL;
-
-                                                pthread_mutex_lock(&planesMutex);
-                                                std::map<std::string, Plane*>::iterator p = planes.find(id);
-                                                if (p != planes.end())
-                                                    plane = p->second;
-                                                else
-                                                {
-                                                    plane = (Plane*) malloc(sizeof(*plane));
-                                                    if (plane != NULL)
-                                                        planes[std::string(id)] = plane;
-                                                }
-
-                                                if (plane != NULL)
-                                                {
-                                                    if (registration == NULL || strlen(registration) == 0)
-                                                        registration = "Unknown";
-                                                    if (icaoId == NULL || strlen(icaoId) == 0)
-                                                        icaoId = "Unknown";
-                                                    if (icaoType == NULL || strlen(icaoType) == 0)
-                                                        icaoType = "UKN";
-                                                    if (squawk == NULL || strlen(squawk) == 0)
-                                                        squawk = "0000";
-                                                    strncpy(plane->registration, registration, sizeof(plane->registration) / sizeof(char));
-                                                    strncpy(plane->icaoId, icaoId, sizeof(plane->icaoId) / sizeof(char));
-                                                    strncpy(plane->icaoType, icaoType, sizeof(plane->icaoType) / sizeof(char));
-                                                    strncpy(plane->squawk, squawk, sizeof(plane->squawk) / sizeof(char));
-                                                    if (plane->latitude != latitudePlane)
-                                                    {
-                                                        plane->latitude = latitudePlane;
-                                                        plane->interpolatedLatitude = 0.0;
-                                                    }
-                                                    if (plane->longitude != longitudePlane)
-                                                    {
-                                                        plane->longitude = longitudePlane;
-                                                        plane->interpolatedLongitude = 0.0;
-                                                    }
-                                                    if (plane->altitude != altitude)
-                                                    {
-                                                        plane->altitude = altitude;
-                                                        plane->interpolatedAltitude = -1000.0;
-                                                    }
-                                                    plane->pitch = 0.0f;
-                                                    plane->roll = 0.0f;
-                                                    plane->heading = heading;
-                                                    plane->speed = speed;
-                                                    plane->verticalSpeed = verticalSpeed;
-                                                    plane->lastSeen = currentTime;
-                                                }
-                                                pthread_mutex_unlock(&planesMutex);
+                                                if (registration == NULL || strlen(registration) == 0)
+                                                    registration = UNKNOWN_ID;
+                                                if (icaoId == NULL || strlen(icaoId) == 0)
+                                                    icaoId = UNKNOWN_ID;
+                                                if (icaoType == NULL || strlen(icaoType) == 0)
+                                                    icaoType = "UKN";
+                                                if (squawk == NULL || strlen(squawk) == 0)
+                                                    squawk = "0000";
+
+                                                Plane report;
+                                                memset(&report, 0, sizeof(report));
+                                                strncpy(report.registration, registration, sizeof(report.registration) / sizeof(char) - 1);
+                                                strncpy(report.icaoId, icaoId, sizeof(report.icaoId) / sizeof(char) - 1);
+                                                strncpy(report.icaoType, icaoType, sizeof(report.icaoType) / sizeof(char) - 1);
+                                                strncpy(report.squawk, squawk, sizeof(report.squawk) / sizeof(char) - 1);
+                                                report.modeSAddress = GetModeSAddress(modeSAddress, id);
+                                                report.latitude = latitudePlane;
+                                                report.longitude = longitudePlane;
+                                                report.altitude = altitude;
+                                                report.heading = heading;
+                                                report.speed = speed;
+                                                report.verticalSpeed = verticalSpeed;
+                                                report.timestamp = timestamp != 0 ? timestamp : currentTime;
+                                                report.lastSeen = currentTime;
+
+                                                UpdateTrackedPlane(id, &report);
                                             }
                                         }
                                     }
                                 }
                             }
+
+                            // planes beyond the capacity of the sim thread's arrays are not shown at all, so this must not go unnoticed
+                            if (droppedPlanes > 0)
+                            {
+                                double values[] = { (double) MAX_TRACKED_PLANES, (double) droppedPlanes };
+                                LogValues(LOG_LEVEL_WARNING, LOG_CATEGORY_TRAFFIC, "All %.0f slots are in use, %.0f new planes were dropped", NULL, 2, values);
+                                droppedPlanes = 0;
+                            }
                         }
 
                         json_value_free(rootJson);
@@ -529,59 +696,72 @@ static void *UpdateThreadFunction(void *ptr)
         pthread_mutex_unlock(&positionMutex);
 
         char *balancerUrl = GetBalancerUrl();
-//        printf("URL -> %s\n", balancerUrl);
         if (balancerUrl != NULL)
         {
             char *zoneName = GetZoneName(latitude, longitude);
             if (zoneName != NULL)
             {
-//                printf("ZONE -> %s\n", zoneName);
+                LogValues(LOG_LEVEL_DEBUG, LOG_CATEGORY_NETWORK, "Zone = %s", zoneName, 0, NULL);
                 UpdatePlanes(balancerUrl, zoneName, latitude, longitude);
                 free(zoneName);
                 zoneName = NULL;
             }
+            else
+                LogString(LOG_LEVEL_WARNING, LOG_CATEGORY_NETWORK, "No zone found for the current position");
 
             free(balancerUrl);
             balancerUrl = NULL;
         }
+        else
+            LogString(LOG_LEVEL_WARNING, LOG_CATEGORY_NETWORK, "No balancer available");
 
         sleep(3);
     }
 }
 
-// provides safe writing access to the users position
+// provides safe writing access to the users position, if the update thread is currently reading the position the update is skipped instead of blocking
 void SetPosition(double latitude, double longitude)
 {
-    pthread_mutex_lock(&positionMutex);
-    userLatitude = latitude;
-    userLongitude = longitude;
-    pthread_mutex_unlock(&positionMutex);
+    if (pthread_mutex_trylock(&positionMutex) == 0)
+    {
+        userLatitude = latitude;
+        userLongitude = longitude;
+        pthread_mutex_unlock(&positionMutex);
+    }
+}
+
+// removes the oldest pending delta from the queue, returns 0 if the queue is empty, never blocks or allocates
+int PopDelta(Delta *delta)
+{
+    return deltaQueue.Pop(delta);
 }
 
 // initilializes the update thread and the mutexes
 void Init(void)
 {
-    pthread_mutex_init(&planesMutex, 0);
     pthread_mutex_init(&positionMutex, 0);
+
+    freeSlotStart = 0;
+    freeSlotCount = 0;
+    for (int slot = 0; slot < MAX_TRACKED_PLANES; slot++)
+        freeSlots[freeSlotCount++] = (unsigned short) slot;
+
+    for (int bucket = 0; bucket < EXPIRY_WHEEL_SIZE; bucket++)
+        expiryBuckets[bucket] = -1;
+    expiryTime = 0;
+
     pthread_create(&thread, NULL, UpdateThreadFunction, NULL);
 }
 
 // uninitializes the reserved memory, thread and mutexes
 void Cleanup(void)
 {
-    pthread_mutex_lock(&planesMutex);
-    for (std::map<std::string, Plane*>::iterator p = planes.begin(); p != planes.end(); ++p)
-    {
-        Plane *plane = p->second;
-        free(plane);
-        plane = NULL;
-        planes.erase(p->first);
-    }
-    pthread_mutex_unlock(&planesMutex);
     pthread_cancel(thread);
-    pthread_mutex_destroy(&planesMutex);
+    pthread_join(thread, NULL);
     pthread_mutex_destroy(&positionMutex);
 
+    trackedPlanes.clear();
+
     if (lastZone != NULL)
         free(lastZone);
 }
@@ -1,34 +1,69 @@
 #ifndef API_H
 #define API_H
 
-#include <map>
-#include <string>
 #include <time.h>
 
-// define plane struct
+// define placeholder of a registration or ICAO flight ID that is missing in a report
+#define UNKNOWN_ID "Unknown"
+
+// define plane struct, the last reported state of a plane
 struct Plane
 {
     char registration[10]; // registration number
     char icaoId[9]; // ICAO flight ID
     char icaoType[5]; // ICAO aircraft type designator
     char squawk[5]; // squawk code
+    unsigned int modeSAddress; // 24 bit ICAO address, derived from the feed's key if it is not reported
     double latitude; // degrees
     double longitude; // degrees
     double altitude; // feet MSL
-    float pitch; // degrees
-    float roll; // degrees
     float heading; // degrees
     int speed; // knots
     int verticalSpeed; // feet per minute
+    time_t timestamp; // UNIX time in seconds at which the position was reported
     time_t lastSeen; // seconds
-    double interpolatedLatitude; // degrees
-    double interpolatedLongitude; // degrees
-    double interpolatedAltitude; // degrees
 };
 
-// external variables
-extern std::map<std::string, Plane*> planes;
-extern pthread_mutex_t planesMutex;
+// define maximum number of planes that can be tracked at the same time, can be raised for the benchmarks up to 65535 so that every slot fits into an unsigned short with a value to spare
+#ifndef MAX_TRACKED_PLANES
+#define MAX_TRACKED_PLANES 8192
+#endif
+
+// define delta types
+#define DELTA_ADD 0
+#define DELTA_UPDATE 1
+#define DELTA_REMOVE 2
+
+// define delta field flags
+#define DELTA_FIELD_POSITION 1 // latitude and longitude
+#define DELTA_FIELD_ALTITUDE 2
+#define DELTA_FIELD_HEADING 4
+#define DELTA_FIELD_SPEED 8
+#define DELTA_FIELD_VERTICAL_SPEED 16
+#define DELTA_FIELD_IDENTITY 32 // registration, ICAO flight ID, ICAO aircraft type, squawk and Mode S address
+
+// define delta struct, describes a change of a single tracked plane and is sent from the update thread to the sim thread
+struct Delta
+{
+    unsigned short slot; // slot of the plane, stable for as long as the plane is tracked
+    unsigned char type; // one of the DELTA_* types
+    unsigned char fields; // DELTA_FIELD_* flags of the values below that are valid
+    float heading; // degrees
+    int speed; // knots
+    int verticalSpeed; // feet per minute
+    double latitude; // degrees
+    double longitude; // degrees
+    double altitude; // feet MSL
+    double timestamp; // UNIX time in seconds at which the position was reported
+    char registration[10]; // registration number
+    char icaoId[9]; // ICAO flight ID
+    char icaoType[5]; // ICAO aircraft type designator
+    char squawk[5]; // squawk code
+    unsigned int modeSAddress; // 24 bit ICAO address
+};
+
+// removes the oldest pending delta from the queue, returns 0 if the queue is empty, never blocks or allocates
+int PopDelta(Delta *delta);
 
 // provides safe writing access to the users position
 void SetPosition(double latitude, double longitude);
@@ -0,0 +1,143 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "../api.h"
+#include "../ringbuffer.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// define number of aircraft of the burst, a busy zone that appears at once after the plugin starts or the zone changes
+#define BURST_AIRCRAFT 5000
+
+// define number of rounds, each round adds all aircraft, updates them once and removes them
+#define ROUNDS 20
+
+// define capacity of the delta queue and number of deltas the sim thread applies per flight loop, must match api.cpp and x_fr24.cpp
+#define DELTA_QUEUE_SIZE 4096
+#define MAX_DELTAS_PER_FLIGHT_LOOP 4096
+
+// define interval between two flight loops in microseconds, 60 frames per second
+#define FRAME_INTERVAL 16667
+
+// global variables
+static RingBuffer<Delta, DELTA_QUEUE_SIZE> deltaQueue;
+static double producerWaitTime = 0.0, producerTime = 0.0;
+static int producerWaits = 0;
+static volatile bool producerDone = false;
+
+// returns a monotonic time in seconds
+static double GetTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec / 1000000000.0;
+}
+
+// appends a delta to the queue with the same back-pressure as PushDelta in api.cpp and records how long the producer waited
+static void PushDelta(const Delta *delta)
+{
+    if (deltaQueue.Push(*delta))
+        return;
+
+    double start = GetTime();
+    while (!deltaQueue.Push(*delta))
+        usleep(1000);
+    producerWaitTime += GetTime() - start;
+    producerWaits++;
+}
+
+// thread function of the producer, sends the deltas of every round as fast as the update thread would after parsing a zone
+static void *ProducerThreadFunction(void *ptr)
+{
+    double start = GetTime();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        for (unsigned char type = DELTA_ADD; type <= DELTA_REMOVE; type++)
+        {
+            for (int a = 0; a < BURST_AIRCRAFT; a++)
+            {
+                Delta delta;
+                memset(&delta, 0, sizeof(delta));
+                delta.slot = (unsigned short) a;
+                delta.type = type;
+                delta.fields = type == DELTA_ADD ? DELTA_FIELD_POSITION | DELTA_FIELD_ALTITUDE | DELTA_FIELD_HEADING | DELTA_FIELD_SPEED | DELTA_FIELD_VERTICAL_SPEED | DELTA_FIELD_IDENTITY : (type == DELTA_UPDATE ? DELTA_FIELD_POSITION | DELTA_FIELD_ALTITUDE : 0);
+                delta.latitude = 48.0 + a * 0.0001;
+                delta.longitude = 11.0 + r * 0.0001;
+                delta.altitude = 10000.0;
+                PushDelta(&delta);
+            }
+        }
+    }
+    producerTime = GetTime() - start;
+    producerDone = true;
+
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t producer;
+    pthread_create(&producer, NULL, ProducerThreadFunction, NULL);
+
+    // the consumer runs like the flight loop, drains up to the limit and then sleeps until the next frame
+    int frames = 0, drainingFrames = 0, popped = 0, outOfOrder = 0, maxFrameDeltas = 0;
+    int expectedSlot = 0, expectedType = DELTA_ADD;
+    double popTime = 0.0, maxFrameTime = 0.0;
+    while (!producerDone || popped < ROUNDS * 3 * BURST_AIRCRAFT)
+    {
+        double start = GetTime();
+        Delta delta;
+        int count = 0;
+        for (; count < MAX_DELTAS_PER_FLIGHT_LOOP && deltaQueue.Pop(&delta); count++)
+        {
+            if (delta.slot != expectedSlot || delta.type != expectedType)
+                outOfOrder++;
+
+            if (++expectedSlot == BURST_AIRCRAFT)
+            {
+                expectedSlot = 0;
+                expectedType = expectedType == DELTA_REMOVE ? DELTA_ADD : expectedType + 1;
+            }
+        }
+        double frameTime = GetTime() - start;
+
+        frames++;
+        if (count > 0)
+        {
+            drainingFrames++;
+            popped += count;
+            popTime += frameTime;
+            maxFrameTime = frameTime > maxFrameTime ? frameTime : maxFrameTime;
+            maxFrameDeltas = count > maxFrameDeltas ? count : maxFrameDeltas;
+        }
+
+        usleep(FRAME_INTERVAL);
+    }
+    pthread_join(producer, NULL);
+
+    printf("%d rounds of %d aircraft added, updated and removed, %d deltas of %d bytes\n", ROUNDS, BURST_AIRCRAFT, popped, (int) sizeof(Delta));
+    printf("producer: %.1f ms per round, waited %d times for %.1f ms per round\n", producerTime / ROUNDS * 1000.0, producerWaits, producerWaitTime / ROUNDS * 1000.0);
+    printf("consumer: %.1f flight loops per round, %.1f ns per delta, at most %d deltas and %.0f us in one flight loop, %d out of order\n", drainingFrames / (double) ROUNDS, popTime / popped * 1e9, maxFrameDeltas, maxFrameTime * 1e6, outOfOrder);
+
+    return outOfOrder == 0 && popped == ROUNDS * 3 * BURST_AIRCRAFT ? 0 : 1;
+}
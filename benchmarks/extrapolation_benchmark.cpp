@@ -0,0 +1,163 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+// the traffic module is included so that its static extrapolation functions can be compared directly
+#include "../traffic.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// define number of extrapolated frames per plane count
+#define FRAMES 2000
+
+// define largest allowed difference between the SSE2 and the scalar results, the SSE2 kernel converts the floats to doubles in a different order
+#define MAX_POSITION_DIFFERENCE 1e-6 // meters
+#define MAX_ALTITUDE_DIFFERENCE 1e-6 // feet
+#define MAX_ANGLE_DIFFERENCE 1e-3f // degrees
+
+// global variables
+static double referenceX[MAX_TRACKED_PLANES], referenceY[MAX_TRACKED_PLANES], referenceZ[MAX_TRACKED_PLANES], referenceAltitude[MAX_TRACKED_PLANES];
+static float referenceHeading[MAX_TRACKED_PLANES], referenceRoll[MAX_TRACKED_PLANES], referencePitch[MAX_TRACKED_PLANES];
+
+// the benchmark runs on one thread and has no X-Plane or spatial index
+void ParallelFor(int count, int chunkSize, ParallelFunction function, void *context)
+{
+    function(0, count, context);
+}
+
+void IndexPlane(unsigned short slot, double latitude, double longitude)
+{
+}
+
+void UnindexPlane(unsigned short slot)
+{
+}
+
+void ClearSpatialIndex(void)
+{
+}
+
+void XPLMWorldToLocal(double latitude, double longitude, double altitude, double *x, double *y, double *z)
+{
+    *x = *y = *z = 0.0;
+}
+
+// returns a random number between min and max
+static double Random(double min, double max)
+{
+    return min + (max - min) * (rand() / (double) RAND_MAX);
+}
+
+// fills the traffic with count planes in all states the extrapolation distinguishes, reports up to MAX_REPORT_AGE old, turns that have and have not ended, fading and faded out corrections
+static void LoadPlanes(int count)
+{
+    traffic.count = count;
+    for (int i = 0; i < count; i++)
+    {
+        traffic.anchorX[i] = Random(-50000.0, 50000.0);
+        traffic.anchorY[i] = Random(0.0, 12000.0);
+        traffic.anchorZ[i] = Random(-50000.0, 50000.0);
+        traffic.anchorTime[i] = -Random(0.0, MAX_REPORT_AGE);
+        traffic.correctionX[i] = Random(-100.0, 100.0);
+        traffic.correctionY[i] = Random(-30.0, 30.0);
+        traffic.correctionZ[i] = Random(-100.0, 100.0);
+        traffic.correctionAltitude[i] = Random(-100.0, 100.0);
+        traffic.correctionTime[i] = -Random(0.0, 2.0 * CORRECTION_TIME);
+        traffic.velocityX[i] = (float) Random(-250.0, 250.0);
+        traffic.velocityY[i] = (float) Random(-20.0, 20.0);
+        traffic.velocityZ[i] = (float) Random(-250.0, 250.0);
+        traffic.turnRate[i] = (float) DegreesToRadians(Random(-MAX_TURN_RATE, MAX_TURN_RATE));
+        traffic.speedRate[i] = (float) Random(-0.02, 0.02);
+        traffic.altitude[i] = Random(0.0, 40000.0);
+        traffic.verticalSpeed[i] = (float) Random(-4000.0, 4000.0);
+        traffic.trackHeading[i] = (float) Random(0.0, 360.0);
+        traffic.bankAngle[i] = (float) Random(-MAX_BANK_ANGLE, MAX_BANK_ANGLE);
+    }
+}
+
+// returns the difference between two headings in degrees
+static float GetHeadingDifference(float a, float b)
+{
+    float difference = fabsf(a - b);
+    return difference > 180.0f ? 360.0f - difference : difference;
+}
+
+// compares the extrapolation of the given plane count with the scalar functions and measures both, returns the number of planes whose results differ
+static int CheckExtrapolation(int planeCount)
+{
+    LoadPlanes(planeCount);
+
+    double time = 0.0;
+    ExtrapolateTraffic(time);
+
+    int mismatches = 0;
+    for (int i = 0; i < traffic.count; i++)
+    {
+        PredictPlane(i, time, &referenceX[i], &referenceY[i], &referenceZ[i], &referenceAltitude[i], &referenceHeading[i], &referenceRoll[i]);
+        referencePitch[i] = GetPitch(traffic.velocityX[i], traffic.velocityY[i], traffic.velocityZ[i]);
+
+        if (fabs(traffic.x[i] - referenceX[i]) > MAX_POSITION_DIFFERENCE || fabs(traffic.y[i] - referenceY[i]) > MAX_POSITION_DIFFERENCE || fabs(traffic.z[i] - referenceZ[i]) > MAX_POSITION_DIFFERENCE || fabs(traffic.interpolatedAltitude[i] - referenceAltitude[i]) > MAX_ALTITUDE_DIFFERENCE || GetHeadingDifference(traffic.interpolatedHeading[i], referenceHeading[i]) > MAX_ANGLE_DIFFERENCE || traffic.roll[i] != referenceRoll[i] || fabsf(traffic.pitch[i] - referencePitch[i]) > MAX_ANGLE_DIFFERENCE)
+            mismatches++;
+    }
+
+    // every frame is a little later so that the compiler cannot hoist the work out of the loop
+    clock_t start = clock();
+    for (int f = 0; f < FRAMES; f++)
+        ExtrapolateTraffic(f * 0.01);
+    double kernelTime = (clock() - start) / (double) CLOCKS_PER_SEC;
+
+    start = clock();
+    for (int f = 0; f < FRAMES; f++)
+    {
+        for (int i = 0; i < traffic.count; i++)
+        {
+            PredictPlane(i, f * 0.01, &referenceX[i], &referenceY[i], &referenceZ[i], &referenceAltitude[i], &referenceHeading[i], &referenceRoll[i]);
+            referencePitch[i] = GetPitch(traffic.velocityX[i], traffic.velocityY[i], traffic.velocityZ[i]);
+        }
+    }
+    double scalarTime = (clock() - start) / (double) CLOCKS_PER_SEC;
+
+    double planes = (double) FRAMES * traffic.count;
+#if defined(__SSE2__)
+    const char *kernel = "SSE2";
+#else
+    const char *kernel = "scalar";
+#endif
+    printf("%5d planes: %s %.2f ns per plane, scalar %.2f ns per plane, speedup %.2fx, %d/%d mismatches\n", traffic.count, kernel, kernelTime / planes * 1e9, scalarTime / planes * 1e9, scalarTime / kernelTime, mismatches, traffic.count);
+
+    return mismatches;
+}
+
+int main(void)
+{
+    srand(1);
+
+    // MAX_TRACKED_PLANES is the capacity of the traffic arrays, larger counts cannot be loaded, odd counts exercise the scalar remainder of the SSE2 loops
+    int mismatches = 0;
+    int planeCounts[] = { 1, 7, 1000, 4001, 10000, 50000 };
+    for (unsigned int c = 0; c < sizeof(planeCounts) / sizeof(planeCounts[0]); c++)
+    {
+        if (planeCounts[c] <= MAX_TRACKED_PLANES)
+            mismatches += CheckExtrapolation(planeCounts[c]);
+        else
+            printf("%5d planes: skipped, MAX_TRACKED_PLANES is %d\n", planeCounts[c], MAX_TRACKED_PLANES);
+    }
+
+    return mismatches == 0 ? 0 : 1;
+}
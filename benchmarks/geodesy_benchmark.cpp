@@ -0,0 +1,174 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "../geodesy.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// define radius of the earth in nautical miles, must match geodesy.cpp
+#define RADIUS_EARTH 3440.07
+
+// define radius of the filter in nautical miles, the viewing distance of the plugin
+#define RADIUS 40.0
+
+// define number of random positions per center
+#define RANDOM_POSITIONS 1000000
+
+// define number of positions per center that are placed just inside and just outside of the radius
+#define BOUNDARY_POSITIONS 100000
+
+// define distance to the radius in nautical miles below which the exact result is ambiguous in double precision and not compared
+#define AMBIGUOUS_DISTANCE 1e-9
+
+// define number of times the throughput loops are repeated
+#define THROUGHPUT_REPETITIONS 20
+
+// define test center struct
+struct Center
+{
+    const char *name;
+    double latitude, longitude;
+};
+
+// global variables
+static const Center centers[] = {
+    { "equator", 0.0, 11.0 },
+    { "mid latitude", 48.35, 11.78 },
+    { "high latitude", 75.0, -40.0 },
+    { "near pole", 89.7, 0.0 },
+    { "southern", -33.9, 151.2 },
+    { "antimeridian east", 52.0, 179.9 },
+    { "antimeridian west", -17.0, -179.95 }
+};
+static double latitudes[RANDOM_POSITIONS], longitudes[RANDOM_POSITIONS];
+static unsigned char within[RANDOM_POSITIONS];
+
+// returns a random number between 0 and 1
+static double Random(void)
+{
+    return rand() / (double) RAND_MAX;
+}
+
+// places a position at the given distance and bearing from the center and wraps its longitude into -180 to 180
+static void PlacePosition(const Center *center, double distance, double bearing, double *latitude, double *longitude)
+{
+    GetDestinationPoint(latitude, longitude, center->latitude, center->longitude, distance, bearing, RADIUS_EARTH);
+    if (*longitude > 180.0)
+        *longitude -= 360.0;
+    else if (*longitude < -180.0)
+        *longitude += 360.0;
+}
+
+// filters count positions around the center and compares the result with the haversine distance, returns the number of mismatches
+static int CompareWithHaversine(const Center *center, int count, int *compared)
+{
+    DistanceFilter filter;
+    InitDistanceFilter(&filter, center->latitude, center->longitude, RADIUS);
+    FilterWithinDistance(&filter, latitudes, longitudes, count, within);
+
+    int mismatches = 0;
+    for (int i = 0; i < count; i++)
+    {
+        double distance = GetDistance(center->latitude, center->longitude, latitudes[i], longitudes[i]);
+        if (fabs(distance - RADIUS) < AMBIGUOUS_DISTANCE)
+            continue;
+
+        (*compared)++;
+        if (within[i] != (distance <= RADIUS))
+            mismatches++;
+    }
+
+    return mismatches;
+}
+
+// checks the distance filter against the haversine distance for random positions and for positions near the radius, returns the number of mismatches
+static int CheckAccuracy(void)
+{
+    int mismatches = 0;
+    for (unsigned int c = 0; c < sizeof(centers) / sizeof(centers[0]); c++)
+    {
+        const Center *center = &centers[c];
+
+        // random positions up to twice the radius
+        for (int i = 0; i < RANDOM_POSITIONS; i++)
+            PlacePosition(center, Random() * 2.0 * RADIUS, Random() * 360.0, &latitudes[i], &longitudes[i]);
+        int randomCompared = 0;
+        int randomMismatches = CompareWithHaversine(center, RANDOM_POSITIONS, &randomCompared);
+
+        // positions within a relative distance of 1e-3 down to 1e-8 of the radius on both sides
+        for (int i = 0; i < BOUNDARY_POSITIONS; i++)
+        {
+            double offset = RADIUS * pow(10.0, -3.0 - 5.0 * Random());
+            PlacePosition(center, i % 2 == 0 ? RADIUS - offset : RADIUS + offset, Random() * 360.0, &latitudes[i], &longitudes[i]);
+        }
+        int boundaryCompared = 0;
+        int boundaryMismatches = CompareWithHaversine(center, BOUNDARY_POSITIONS, &boundaryCompared);
+
+        printf("%-18s random %d/%d mismatches, boundary %d/%d mismatches\n", center->name, randomMismatches, randomCompared, boundaryMismatches, boundaryCompared);
+        mismatches += randomMismatches + boundaryMismatches;
+    }
+
+    return mismatches;
+}
+
+// measures the time per position of the haversine distance and of the distance filter for the positions of a typical zone
+static void CheckThroughput(void)
+{
+    const Center *center = &centers[1];
+    for (int i = 0; i < RANDOM_POSITIONS; i++)
+    {
+        latitudes[i] = center->latitude - 8.0 + Random() * 16.0;
+        longitudes[i] = center->longitude - 11.0 + Random() * 22.0;
+    }
+
+    int haversineCount = 0;
+    clock_t start = clock();
+    for (int r = 0; r < THROUGHPUT_REPETITIONS; r++)
+    {
+        for (int i = 0; i < RANDOM_POSITIONS; i++)
+            haversineCount += GetDistance(center->latitude, center->longitude, latitudes[i], longitudes[i]) <= RADIUS;
+    }
+    double haversineTime = (clock() - start) / (double) CLOCKS_PER_SEC;
+
+    DistanceFilter filter;
+    InitDistanceFilter(&filter, center->latitude, center->longitude, RADIUS);
+    int filterCount = 0;
+    start = clock();
+    for (int r = 0; r < THROUGHPUT_REPETITIONS; r++)
+    {
+        FilterWithinDistance(&filter, latitudes, longitudes, RANDOM_POSITIONS, within);
+        for (int i = 0; i < RANDOM_POSITIONS; i++)
+            filterCount += within[i];
+    }
+    double filterTime = (clock() - start) / (double) CLOCKS_PER_SEC;
+
+    double positions = (double) RANDOM_POSITIONS * THROUGHPUT_REPETITIONS;
+    printf("haversine %.2f ns per position, filter %.2f ns per position, speedup %.1fx, %d/%d within\n", haversineTime / positions * 1e9, filterTime / positions * 1e9, haversineTime / filterTime, filterCount, haversineCount);
+}
+
+int main(void)
+{
+    srand(1);
+
+    int mismatches = CheckAccuracy();
+    CheckThroughput();
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,274 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "../geodesy.h"
+#include "../spatial.h"
+#include "../traffic.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// define number of queries of each kind per plane count
+#define QUERIES 2000
+
+// define number of times all planes are moved to measure the cost of keeping the grid up to date
+#define MOVES 20
+
+// define region most planes are spread over in degrees, about the size of the European airspace
+#define REGION_MIN_LATITUDE 35.0
+#define REGION_MAX_LATITUDE 60.0
+#define REGION_MIN_LONGITUDE -10.0
+#define REGION_MAX_LONGITUDE 30.0
+
+// define fraction of the planes and queries that lie in a region across the antimeridian
+#define PACIFIC_FRACTION 0.1
+#define PACIFIC_MIN_LATITUDE 40.0
+#define PACIFIC_MAX_LATITUDE 55.0
+#define PACIFIC_HALF_LONGITUDE 8.0
+
+// define half extent in degrees of a query box, about the area the map window shows at its default zoom
+#define QUERY_HALF_LATITUDE 0.75
+#define QUERY_HALF_LONGITUDE 1.1
+
+// define radius in nautical miles of a radius query, the TCAS range
+#define QUERY_RADIUS 40.0
+
+// define number of planes of a nearest query, the candidates of the multiplayer slots
+#define QUERY_NEAREST 76
+
+// define query kinds
+#define QUERY_BOX 0
+#define QUERY_RADIUS_KIND 1
+#define QUERY_NEAREST_KIND 2
+#define QUERY_KIND_COUNT 3
+
+// define scan candidate struct used to find the nearest planes by scanning all planes
+struct ScanCandidate
+{
+    double distance;
+    int index;
+
+    bool operator<(const ScanCandidate &other) const
+    {
+        return distance < other.distance;
+    }
+};
+
+// global variables
+Traffic traffic;
+static int indices[MAX_TRACKED_PLANES]; // index of the plane in each slot
+static int indexResults[MAX_TRACKED_PLANES], scanResults[MAX_TRACKED_PLANES];
+static ScanCandidate scanCandidates[MAX_TRACKED_PLANES];
+static double queryLatitudes[QUERIES], queryLongitudes[QUERIES];
+static const char *queryNames[QUERY_KIND_COUNT] = {"box", "radius", "nearest"};
+
+// returns the index of the plane in the given slot, -1 if the slot is unused
+int FindPlane(unsigned short slot)
+{
+    int i = indices[slot];
+    return i < traffic.count && traffic.slot[i] == slot ? i : -1;
+}
+
+// returns a random number between min and max
+static double Random(double min, double max)
+{
+    return min + (max - min) * (rand() / (double) RAND_MAX);
+}
+
+// returns a random position in one of the regions
+static void RandomPosition(double *latitude, double *longitude)
+{
+    if (Random(0.0, 1.0) < PACIFIC_FRACTION)
+    {
+        *latitude = Random(PACIFIC_MIN_LATITUDE, PACIFIC_MAX_LATITUDE);
+        *longitude = Random(180.0 - PACIFIC_HALF_LONGITUDE, 180.0 + PACIFIC_HALF_LONGITUDE);
+        if (*longitude >= 180.0)
+            *longitude -= 360.0;
+    }
+    else
+    {
+        *latitude = Random(REGION_MIN_LATITUDE, REGION_MAX_LATITUDE);
+        *longitude = Random(REGION_MIN_LONGITUDE, REGION_MAX_LONGITUDE);
+    }
+}
+
+// adds a plane in the given slot at a random position
+static void AddPlane(unsigned short slot)
+{
+    int i = traffic.count++;
+    traffic.slot[i] = slot;
+    RandomPosition(&traffic.latitude[i], &traffic.longitude[i]);
+    indices[slot] = i;
+    IndexPlane(slot, traffic.latitude[i], traffic.longitude[i]);
+}
+
+// fills the traffic with count planes at random positions, replaces some of them with the swap-remove of the sim thread so that indices and slots differ
+static void LoadPlanes(int count)
+{
+    ClearSpatialIndex();
+    traffic.count = 0;
+    for (int i = 0; i < count; i++)
+        AddPlane((unsigned short) i);
+
+    for (int r = 0; r < count / 10; r++)
+    {
+        int i = rand() % traffic.count;
+        unsigned short slot = traffic.slot[i];
+        UnindexPlane(slot);
+
+        int last = --traffic.count;
+        traffic.slot[i] = traffic.slot[last];
+        traffic.latitude[i] = traffic.latitude[last];
+        traffic.longitude[i] = traffic.longitude[last];
+        indices[traffic.slot[i]] = i;
+
+        AddPlane(slot);
+    }
+}
+
+// runs a query of the given kind around the given position on the grid, writes the indices of the planes into results and returns their number
+static int RunIndexQuery(int kind, double latitude, double longitude, int *results)
+{
+    if (kind == QUERY_BOX)
+        return QueryBox(latitude - QUERY_HALF_LATITUDE, longitude - QUERY_HALF_LONGITUDE, latitude + QUERY_HALF_LATITUDE, longitude + QUERY_HALF_LONGITUDE, results, MAX_TRACKED_PLANES);
+    if (kind == QUERY_RADIUS_KIND)
+        return QueryRadius(latitude, longitude, QUERY_RADIUS, results, MAX_TRACKED_PLANES);
+
+    return QueryNearest(latitude, longitude, QUERY_NEAREST, results);
+}
+
+// runs a query of the given kind around the given position by scanning all planes, writes the indices of the planes into results and returns their number
+static int RunScanQuery(int kind, double latitude, double longitude, int *results)
+{
+    int count = 0;
+    if (kind == QUERY_BOX)
+    {
+        for (int i = 0; i < traffic.count; i++)
+        {
+            if (traffic.latitude[i] >= latitude - QUERY_HALF_LATITUDE && traffic.latitude[i] <= latitude + QUERY_HALF_LATITUDE && traffic.longitude[i] >= longitude - QUERY_HALF_LONGITUDE && traffic.longitude[i] <= longitude + QUERY_HALF_LONGITUDE)
+                results[count++] = i;
+        }
+
+        return count;
+    }
+
+    double cosLatitude = cos(DegreesToRadians(latitude));
+    if (kind == QUERY_RADIUS_KIND)
+    {
+        for (int i = 0; i < traffic.count; i++)
+        {
+            if (GetApproximateSquaredDistance(latitude, longitude, traffic.latitude[i], traffic.longitude[i], cosLatitude) <= QUERY_RADIUS * QUERY_RADIUS)
+                results[count++] = i;
+        }
+
+        return count;
+    }
+
+    for (int i = 0; i < traffic.count; i++)
+    {
+        scanCandidates[i].distance = GetApproximateSquaredDistance(latitude, longitude, traffic.latitude[i], traffic.longitude[i], cosLatitude);
+        scanCandidates[i].index = i;
+    }
+
+    count = std::min(QUERY_NEAREST, traffic.count);
+    std::nth_element(scanCandidates, scanCandidates + count, scanCandidates + traffic.count);
+    for (int c = 0; c < count; c++)
+        results[c] = scanCandidates[c].index;
+
+    return count;
+}
+
+// compares the grid with a scan of all planes for every kind of query and measures both, returns the number of queries whose results differ
+static int CheckQueries(int planeCount)
+{
+    LoadPlanes(planeCount);
+
+    for (int q = 0; q < QUERIES; q++)
+        RandomPosition(&queryLatitudes[q], &queryLongitudes[q]);
+
+    int mismatches = 0;
+    for (int kind = 0; kind < QUERY_KIND_COUNT; kind++)
+    {
+        int kindMismatches = 0, found = 0;
+        for (int q = 0; q < QUERIES; q++)
+        {
+            // the box query does not support boxes across the antimeridian
+            if (kind == QUERY_BOX && fabs(queryLongitudes[q]) + QUERY_HALF_LONGITUDE > 180.0)
+                continue;
+
+            int indexCount = RunIndexQuery(kind, queryLatitudes[q], queryLongitudes[q], indexResults);
+            int scanCount = RunScanQuery(kind, queryLatitudes[q], queryLongitudes[q], scanResults);
+
+            std::sort(indexResults, indexResults + indexCount);
+            std::sort(scanResults, scanResults + scanCount);
+            if (indexCount != scanCount || !std::equal(indexResults, indexResults + indexCount, scanResults))
+                kindMismatches++;
+            found += scanCount;
+        }
+
+        clock_t start = clock();
+        for (int q = 0; q < QUERIES; q++)
+            RunIndexQuery(kind, queryLatitudes[q], queryLongitudes[q], indexResults);
+        double indexTime = (clock() - start) / (double) CLOCKS_PER_SEC;
+
+        start = clock();
+        for (int q = 0; q < QUERIES; q++)
+            RunScanQuery(kind, queryLatitudes[q], queryLongitudes[q], scanResults);
+        double scanTime = (clock() - start) / (double) CLOCKS_PER_SEC;
+
+        printf("%5d planes, %-7s: grid %8.2f us per query, scan %8.2f us per query, %6.1f planes per query, %d/%d mismatches\n", traffic.count, queryNames[kind], indexTime / QUERIES * 1e6, scanTime / QUERIES * 1e6, found / (double) QUERIES, kindMismatches, QUERIES);
+        mismatches += kindMismatches;
+    }
+
+    // every plane moves by up to a cell per report, as fast planes do between two reports
+    clock_t start = clock();
+    for (int m = 0; m < MOVES; m++)
+    {
+        for (int i = 0; i < traffic.count; i++)
+        {
+            traffic.latitude[i] += Random(-0.05, 0.05);
+            traffic.longitude[i] += Random(-0.05, 0.05);
+            traffic.longitude[i] += traffic.longitude[i] >= 180.0 ? -360.0 : (traffic.longitude[i] < -180.0 ? 360.0 : 0.0);
+            IndexPlane(traffic.slot[i], traffic.latitude[i], traffic.longitude[i]);
+        }
+    }
+    double moveTime = (clock() - start) / (double) CLOCKS_PER_SEC;
+    printf("%5d planes, update : %.1f ns per plane\n", traffic.count, moveTime / MOVES / traffic.count * 1e9);
+
+    return mismatches;
+}
+
+int main(void)
+{
+    srand(1);
+
+    // the benchmark is built with a larger MAX_TRACKED_PLANES than the plugin so that busier airspaces than the plugin tracks can be measured
+    int mismatches = 0;
+    int planeCounts[] = { 1000, 10000, 50000 };
+    for (unsigned int c = 0; c < sizeof(planeCounts) / sizeof(planeCounts[0]); c++)
+    {
+        if (planeCounts[c] <= MAX_TRACKED_PLANES)
+            mismatches += CheckQueries(planeCounts[c]);
+        else
+            printf("%5d planes: skipped, MAX_TRACKED_PLANES is %d\n", planeCounts[c], MAX_TRACKED_PLANES);
+    }
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "drawlist.h"
+#include "geodesy.h"
+#include "selection.h"
+#include "traffic.h"
+
+#include <math.h>
+
+// define radius in meters of a sphere that encloses any plane, used for the culling
+#define PLANE_RADIUS 40.0
+
+// define minimum projected diameter in pixels of a plane that is drawn
+#define MIN_PROJECTED_SIZE 1.5
+
+// define projected diameters in pixels above which planes are drawn with their full model and the proxy model, smaller planes are drawn as impostors
+#define FULL_DETAIL_SIZE 48.0
+#define PROXY_DETAIL_SIZE 12.0
+
+// define fraction by which the projected size has to cross a tier threshold before the tier of a plane changes, prevents popping
+#define DETAIL_HYSTERESIS 0.2
+
+// define camera struct, the view the planes are culled against
+struct Camera
+{
+    double x, y, z; // OpenGL local coordinates in meters
+    double forward[3], right[3], up[3]; // unit vectors of the view direction
+    double tanHalfWidth, tanHalfHeight; // tangents of half the horizontal and vertical field of view
+    double secHalfWidth, secHalfHeight; // secants of half the horizontal and vertical field of view
+    double pixelsPerMeter; // projected size in pixels of one meter at a depth of one meter
+    bool valid;
+};
+
+// external variables
+XPLMDrawInfo_t drawInfos[MAX_TRACKED_PLANES];
+DrawBatch drawBatches[MAX_DRAW_BATCHES];
+int drawBatchCount = 0;
+int culledCount = 0;
+float impostorVertices[MAX_TRACKED_PLANES * 3];
+int impostorCount = 0;
+
+// global variables
+static Camera camera;
+static int planeBatches[MAX_TRACKED_PLANES]; // batch of each selected plane, -1 if it is not drawn
+
+// returns the projected diameter in pixels of a plane at the given position, -1 if it is outside the view frustum
+static double GetProjectedSize(double x, double y, double z)
+{
+    if (!camera.valid)
+        return HUGE_VAL;
+
+    double dX = x - camera.x, dY = y - camera.y, dZ = z - camera.z;
+    double depth = dX * camera.forward[0] + dY * camera.forward[1] + dZ * camera.forward[2];
+
+    // behind the camera
+    if (depth < -PLANE_RADIUS)
+        return -1.0;
+
+    // outside the side planes of the frustum, the bounding sphere is tested against the planes' normals
+    double horizontal = fabs(dX * camera.right[0] + dY * camera.right[1] + dZ * camera.right[2]);
+    if (horizontal - depth * camera.tanHalfWidth > PLANE_RADIUS * camera.secHalfWidth)
+        return -1.0;
+
+    double vertical = fabs(dX * camera.up[0] + dY * camera.up[1] + dZ * camera.up[2]);
+    if (vertical - depth * camera.tanHalfHeight > PLANE_RADIUS * camera.secHalfHeight)
+        return -1.0;
+
+    // the camera is inside the bounding sphere
+    if (depth <= PLANE_RADIUS)
+        return HUGE_VAL;
+
+    return 2.0 * PLANE_RADIUS * camera.pixelsPerMeter / depth;
+}
+
+// returns the detail tier for a plane of the given projected size, a plane keeps its previous tier until the size has crossed the threshold by the hysteresis
+static int GetDetailTier(double size, int previousTier)
+{
+    if (previousTier == DETAIL_TIER_FULL && size >= FULL_DETAIL_SIZE * (1.0 - DETAIL_HYSTERESIS))
+        return DETAIL_TIER_FULL;
+    if (previousTier == DETAIL_TIER_PROXY && size >= PROXY_DETAIL_SIZE * (1.0 - DETAIL_HYSTERESIS) && size < FULL_DETAIL_SIZE * (1.0 + DETAIL_HYSTERESIS))
+        return DETAIL_TIER_PROXY;
+    if (previousTier == DETAIL_TIER_IMPOSTOR && size < PROXY_DETAIL_SIZE * (1.0 + DETAIL_HYSTERESIS))
+        return DETAIL_TIER_IMPOSTOR;
+
+    if (size >= FULL_DETAIL_SIZE)
+        return DETAIL_TIER_FULL;
+    if (size >= PROXY_DETAIL_SIZE)
+        return DETAIL_TIER_PROXY;
+
+    return DETAIL_TIER_IMPOSTOR;
+}
+
+// sets the camera the planes are culled against, fieldOfView is the horizontal field of view in degrees and the window size is in pixels
+void SetCullingCamera(const XPLMCameraPosition_t *position, float fieldOfView, int windowWidth, int windowHeight)
+{
+    camera.valid = fieldOfView > 0.0f && fieldOfView < 180.0f && windowWidth > 0 && windowHeight > 0;
+    if (!camera.valid)
+        return;
+
+    camera.x = position->x;
+    camera.y = position->y;
+    camera.z = position->z;
+
+    // the camera faces north along -Z with zero rotations, heading turns it clockwise, pitch up and roll to the right
+    double heading = DegreesToRadians(position->heading), pitch = DegreesToRadians(position->pitch), roll = DegreesToRadians(position->roll);
+    double forward[3] = {sin(heading) * cos(pitch), sin(pitch), -cos(heading) * cos(pitch)};
+    double right[3] = {cos(heading), 0.0, sin(heading)};
+    double up[3] = {-sin(heading) * sin(pitch), cos(pitch), cos(heading) * sin(pitch)};
+    for (int k = 0; k < 3; k++)
+    {
+        camera.forward[k] = forward[k];
+        camera.right[k] = right[k] * cos(roll) - up[k] * sin(roll);
+        camera.up[k] = up[k] * cos(roll) + right[k] * sin(roll);
+    }
+
+    double zoom = position->zoom > 0.0f ? position->zoom : 1.0;
+    camera.tanHalfWidth = tan(DegreesToRadians(fieldOfView) / 2.0) / zoom;
+    camera.tanHalfHeight = camera.tanHalfWidth * windowHeight / windowWidth;
+    camera.secHalfWidth = sqrt(1.0 + camera.tanHalfWidth * camera.tanHalfWidth);
+    camera.secHalfHeight = sqrt(1.0 + camera.tanHalfHeight * camera.tanHalfHeight);
+    camera.pixelsPerMeter = windowWidth / 2.0 / camera.tanHalfWidth;
+}
+
+// builds the draw list from the selected planes that are inside the view frustum and large enough to be seen, planeObjects holds the model of each selected plane or NULL if it is not available, proxyObject is drawn for planes of medium projected size and may be NULL, must be called from the sim thread
+void BuildDrawList(const XPLMObjectRef *planeObjects, XPLMObjectRef proxyObject)
+{
+    drawBatchCount = 0;
+    culledCount = 0;
+    impostorCount = 0;
+
+    // choose the detail tier of each plane, assign the planes that are drawn with a model to the batch of that model and count the instances, there are only a few different models so a linear search is sufficient
+    for (int s = 0; s < selectedCount; s++)
+    {
+        planeBatches[s] = -1;
+
+        // planes in a multiplayer slot are rendered by X-Plane itself
+        int i = selectedIndices[s];
+        if (traffic.multiplayer[i])
+        {
+            traffic.detailTier[i] = DETAIL_TIER_NONE;
+            continue;
+        }
+
+        double size = GetProjectedSize(traffic.x[i], traffic.y[i], traffic.z[i]);
+        if (size < MIN_PROJECTED_SIZE)
+        {
+            traffic.detailTier[i] = DETAIL_TIER_NONE;
+            culledCount++;
+            continue;
+        }
+
+        traffic.detailTier[i] = (unsigned char) GetDetailTier(size, traffic.detailTier[i]);
+        if (traffic.detailTier[i] == DETAIL_TIER_IMPOSTOR)
+        {
+            impostorVertices[impostorCount * 3] = (float) traffic.x[i];
+            impostorVertices[impostorCount * 3 + 1] = (float) traffic.y[i];
+            impostorVertices[impostorCount * 3 + 2] = (float) traffic.z[i];
+            impostorCount++;
+            continue;
+        }
+
+        // planes of medium size fall back to their full model if there is no proxy model
+        XPLMObjectRef object = traffic.detailTier[i] == DETAIL_TIER_PROXY && proxyObject != NULL ? proxyObject : planeObjects[s];
+        if (object == NULL)
+            continue;
+
+        int b = 0;
+        while (b < drawBatchCount && drawBatches[b].object != object)
+            b++;
+
+        if (b == drawBatchCount)
+        {
+            if (drawBatchCount == MAX_DRAW_BATCHES)
+                continue;
+
+            drawBatches[b].object = object;
+            drawBatches[b].count = 0;
+            drawBatchCount++;
+        }
+
+        planeBatches[s] = b;
+        drawBatches[b].count++;
+    }
+
+    int first = 0;
+    for (int b = 0; b < drawBatchCount; b++)
+    {
+        drawBatches[b].first = first;
+        first += drawBatches[b].count;
+        drawBatches[b].count = 0;
+    }
+
+    // write the instances into the contiguous range of their batch
+    for (int s = 0; s < selectedCount; s++)
+    {
+        if (planeBatches[s] == -1)
+            continue;
+
+        int i = selectedIndices[s];
+        DrawBatch *batch = &drawBatches[planeBatches[s]];
+        XPLMDrawInfo_t *info = &drawInfos[batch->first + batch->count++];
+
+        info->structSize = sizeof(XPLMDrawInfo_t);
+        info->x = (float) traffic.x[i];
+        info->y = (float) traffic.y[i];
+        info->z = (float) traffic.z[i];
+        info->pitch = traffic.roll[i]; //TODO temp correction for obj orientation!
+        info->heading = traffic.interpolatedHeading[i] + 90.0f; //TODO temp correction for obj orientation!
+        info->roll = traffic.pitch[i]; //TODO temp correction for obj orientation!
+    }
+}
+
+// empties the draw list, must be called when the local coordinate system has moved until the list is rebuilt
+void ClearDrawList(void)
+{
+    drawBatchCount = 0;
+    impostorCount = 0;
+}
@@ -0,0 +1,54 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include "api.h"
+#include "XPLMCamera.h"
+#include "XPLMScenery.h"
+
+// define maximum number of different models that can be drawn in one frame
+#define MAX_DRAW_BATCHES 64
+
+// define draw batch struct, all instances of one model that are drawn with a single call
+struct DrawBatch
+{
+    XPLMObjectRef object;
+    int first; // index of the first instance in drawInfos
+    int count; // number of instances
+};
+
+// external variables
+extern XPLMDrawInfo_t drawInfos[MAX_TRACKED_PLANES]; // instances of all batches, the instances of each batch are contiguous
+extern DrawBatch drawBatches[MAX_DRAW_BATCHES];
+extern int drawBatchCount;
+extern int culledCount; // number of selected planes that were rejected by the culling in the last draw list
+extern float impostorVertices[MAX_TRACKED_PLANES * 3]; // OpenGL local coordinates of the planes that are drawn as impostors
+extern int impostorCount;
+
+// sets the camera the planes are culled against, fieldOfView is the horizontal field of view in degrees and the window size is in pixels
+void SetCullingCamera(const XPLMCameraPosition_t *camera, float fieldOfView, int windowWidth, int windowHeight);
+
+// builds the draw list from the selected planes that are inside the view frustum and large enough to be seen, planeObjects holds the model of each selected plane or NULL if it is not available, proxyObject is drawn for planes of medium projected size and may be NULL, must be called from the sim thread
+void BuildDrawList(const XPLMObjectRef *planeObjects, XPLMObjectRef proxyObject);
+
+// empties the draw list, must be called when the local coordinate system has moved until the list is rebuilt
+void ClearDrawList(void);
+
+#endif
@@ -0,0 +1,113 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "geodesy.h"
+
+// define radius of the earth in nautical miles
+#define RADIUS_EARTH 3440.07
+
+// define relative error of the equirectangular distance that is always allowed for, covers the flat earth error of distances up to several hundred nautical miles
+#define FLAT_EARTH_ERROR 0.001
+
+// define classification of a position that has to be tested exactly
+#define BORDERLINE 2
+
+// returns the haversine of the central angle between the center of the filter and the given position
+inline static double GetHaversine(const DistanceFilter *filter, double latitude, double longitude)
+{
+    double sinHalfDLatitude = sin(DegreesToRadians(latitude - filter->latitude) / 2.0);
+    double sinHalfDLongitude = sin(DegreesToRadians(longitude - filter->longitude) / 2.0);
+
+    return sinHalfDLatitude * sinHalfDLatitude + filter->cosLatitude * cos(DegreesToRadians(latitude)) * sinHalfDLongitude * sinHalfDLongitude;
+}
+
+// calculates the distance between two coordinates in nautical miles
+double GetDistance(double latitudeA, double longitudeA, double latitudeB, double longitudeB)
+{
+    double sinHalfDLatitude = sin(DegreesToRadians(latitudeB - latitudeA) / 2.0);
+    double sinHalfDLongitude = sin(DegreesToRadians(longitudeB - longitudeA) / 2.0);
+    double a = sinHalfDLatitude * sinHalfDLatitude + cos(DegreesToRadians(latitudeA)) * cos(DegreesToRadians(latitudeB)) * sinHalfDLongitude * sinHalfDLongitude;
+
+    return 2.0 * asin(sqrt(a < 1.0 ? a : 1.0)) * RADIUS_EARTH;
+}
+
+// calculates the midpoint between two given coordinates
+void GetMidpoint(double *latitudeMidpoint, double *longitudeMidpoint, double latitudeA, double longitudeA, double latitudeB, double longitudeB)
+{
+    double dLongitude = DegreesToRadians(longitudeB - longitudeA);
+    double bX = cos(DegreesToRadians(latitudeB)) * cos(dLongitude);
+    double bY = cos(DegreesToRadians(latitudeB)) * sin(dLongitude);
+
+    *latitudeMidpoint = RadiansToDegrees(atan2(sin(DegreesToRadians(latitudeA)) + sin(DegreesToRadians(latitudeB)), sqrt((cos(DegreesToRadians(latitudeA)) + bX) * (cos(DegreesToRadians(latitudeA)) + bX) + bY * bY)));
+
+    *longitudeMidpoint = longitudeA + RadiansToDegrees(atan2(bY, cos(DegreesToRadians(latitudeA)) + bX));
+}
+
+// calculates the destination point given distance and bearing from a starting point, distance and earthRadius must be in the same unit
+void GetDestinationPoint(double *destinationLatitude, double *destinationLongitude, double startLatitude, double startLongitude, double distance, double bearing, double earthRadius)
+{
+    double d = distance / earthRadius;
+
+    *destinationLatitude = RadiansToDegrees(asin(sin(DegreesToRadians(startLatitude)) * cos(d) + cos(DegreesToRadians(startLatitude)) * sin(d) * cos(DegreesToRadians(bearing))));
+    *destinationLongitude = RadiansToDegrees(DegreesToRadians(startLongitude) + atan2(sin(DegreesToRadians(bearing)) * sin(d) * cos(DegreesToRadians(startLatitude)), cos(d) - sin(DegreesToRadians(startLatitude)) * sin(DegreesToRadians(*destinationLatitude))));
+}
+
+// prepares a filter for positions within the given radius in nautical miles around the given center
+void InitDistanceFilter(DistanceFilter *filter, double latitude, double longitude, double radius)
+{
+    filter->latitude = latitude;
+    filter->longitude = longitude;
+    filter->cosLatitude = cos(DegreesToRadians(latitude));
+
+    double sinHalfAngle = sin(radius / RADIUS_EARTH / 2.0);
+    filter->haversineThreshold = sinHalfAngle * sinHalfAngle;
+
+    // at the poles every position is tested exactly
+    if (filter->cosLatitude < 1e-9)
+    {
+        filter->innerSquared = 0.0;
+        filter->outerSquared = HUGE_VAL;
+        return;
+    }
+
+    // the equirectangular distance scales the longitude by the cosine of the center's latitude, positions within the radius may lie at latitudes with a smaller or larger cosine
+    double span = radius / 60.0;
+    double cosMin = cos(DegreesToRadians(fmin(fabs(latitude) + span, 90.0)));
+    double cosMax = cos(DegreesToRadians(fmax(fabs(latitude) - span, 0.0)));
+    double lower = fmin(1.0, cosMin / filter->cosLatitude) * (1.0 - FLAT_EARTH_ERROR);
+    double upper = fmax(1.0, cosMax / filter->cosLatitude) * (1.0 + FLAT_EARTH_ERROR);
+
+    filter->innerSquared = (radius / upper) * (radius / upper);
+    filter->outerSquared = lower > 0.0 ? (radius / lower) * (radius / lower) : HUGE_VAL;
+}
+
+// sets within to 1 for every position that lies within the radius of the filter and to 0 for all others, the positions are first classified with the equirectangular distance in a loop the compiler can vectorize and only the borderline ones are tested exactly
+void FilterWithinDistance(const DistanceFilter *filter, const double *latitudes, const double *longitudes, int count, unsigned char *within)
+{
+    for (int i = 0; i < count; i++)
+    {
+        double distanceSquared = GetApproximateSquaredDistance(filter->latitude, filter->longitude, latitudes[i], longitudes[i], filter->cosLatitude);
+        within[i] = distanceSquared <= filter->innerSquared ? 1 : (distanceSquared > filter->outerSquared ? 0 : BORDERLINE);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (within[i] == BORDERLINE)
+            within[i] = GetHaversine(filter, latitudes[i], longitudes[i]) <= filter->haversineThreshold;
+    }
+}
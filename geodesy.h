@@ -0,0 +1,73 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef GEODESY_H
+#define GEODESY_H
+
+#include <math.h>
+
+// define distance filter struct, tests positions against a circle around a center with the cheap equirectangular distance and only falls back to the exact haversine test near the edge of the circle
+struct DistanceFilter
+{
+    double latitude, longitude; // degrees
+    double cosLatitude; // cosine of the center's latitude
+    double innerSquared; // squared equirectangular distance in nautical miles below which a position is certainly inside
+    double outerSquared; // squared equirectangular distance in nautical miles above which a position is certainly outside
+    double haversineThreshold; // haversine of the radius' central angle
+};
+
+// converts from degrees to radians
+inline static double DegreesToRadians(double degrees)
+{
+    return degrees * (M_PI / 180.0);
+}
+
+// converts from radians to degrees
+inline static double RadiansToDegrees(double radians)
+{
+    return radians * (180.0 / M_PI);
+}
+
+// returns the squared distance in nautical miles between two coordinates on the equirectangular projection at the given cosine of the latitude, only accurate for short distances
+inline static double GetApproximateSquaredDistance(double latitudeA, double longitudeA, double latitudeB, double longitudeB, double cosLatitude)
+{
+    double dLongitude = longitudeB - longitudeA;
+    dLongitude = dLongitude > 180.0 ? dLongitude - 360.0 : (dLongitude < -180.0 ? dLongitude + 360.0 : dLongitude);
+
+    double dX = dLongitude * 60.0 * cosLatitude;
+    double dY = (latitudeB - latitudeA) * 60.0;
+
+    return dX * dX + dY * dY;
+}
+
+// calculates the distance between two coordinates in nautical miles
+double GetDistance(double latitudeA, double longitudeA, double latitudeB, double longitudeB);
+
+// calculates the midpoint between two given coordinates
+void GetMidpoint(double *latitudeMidpoint, double *longitudeMidpoint, double latitudeA, double longitudeA, double latitudeB, double longitudeB);
+
+// calculates the destination point given distance and bearing from a starting point, distance and earthRadius must be in the same unit
+void GetDestinationPoint(double *destinationLatitude, double *destinationLongitude, double startLatitude, double startLongitude, double distance, double bearing, double earthRadius);
+
+// prepares a filter for positions within the given radius in nautical miles around the given center
+void InitDistanceFilter(DistanceFilter *filter, double latitude, double longitude, double radius);
+
+// sets within to 1 for every position that lies within the radius of the filter and to 0 for all others, the positions are first classified with the equirectangular distance in a loop the compiler can vectorize and only the borderline ones are tested exactly
+void FilterWithinDistance(const DistanceFilter *filter, const double *latitudes, const double *longitudes, int count, unsigned char *within);
+
+#endif
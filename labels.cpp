@@ -0,0 +1,245 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "labels.h"
+#include "selection.h"
+#include "traffic.h"
+#include "XPLMGraphics.h"
+
+#if APL
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+// define maximum number of characters of a label
+#define LABEL_LENGTH 16
+
+// define distance in pixels between the projected position of a plane and its label
+#define LABEL_OFFSET 8
+
+// define maximum number of cells of the declutter grid per axis, the cells grow on large screens
+#define MAX_GRID_CELLS 128
+
+// define color of the labels
+#define LABEL_COLOR 1.0f, 1.0f, 0.9f
+
+// define slot of a label whose plane has been removed
+#define SLOT_NONE 0xFFFF
+
+// define label struct, a label that has been placed on the screen
+struct Label
+{
+    unsigned short slot; // stable slot of the labelled plane, SLOT_NONE if the plane has been removed
+    int x, y; // window coordinates in pixels of the lower left corner, follow the plane with every projection
+    int width; // pixels
+    int next; // next label in the same grid cell, -1 if there is none
+    bool visible; // false if the plane is not on the screen in the last projection
+    char text[LABEL_LENGTH + 1];
+};
+
+// global variables
+static Label labels[MAX_TRACKED_PLANES];
+static int labelCount = 0;
+static int gridCells[MAX_GRID_CELLS * MAX_GRID_CELLS]; // first label whose corner lies in each cell, -1 if there is none
+static unsigned char labelled[MAX_TRACKED_PLANES]; // 1 if the plane in each slot was labelled by the last layout
+static int slotLabels[MAX_TRACKED_PLANES]; // label of the plane in each slot if it is labelled
+static unsigned short projectedSlots[MAX_TRACKED_PLANES]; // slots of the planes that were on the screen in the last projection
+static float projectedX[MAX_TRACKED_PLANES], projectedY[MAX_TRACKED_PLANES]; // window coordinates of each projected plane, projectedX is negative once its label has been rejected
+static int projectedCount = 0;
+static int viewport[4]; // viewport of the last projection
+static bool layoutPending = false; // true if the planes have been projected since the last layout
+
+// multiplies a 4x4 column-major matrix with the point (x, y, z, 1)
+inline static void TransformPoint(const float *m, double x, double y, double z, double *out)
+{
+    for (int r = 0; r < 4; r++)
+        out[r] = m[r] * x + m[4 + r] * y + m[8 + r] * z + m[12 + r];
+}
+
+// projects the plane at the given index into window coordinates, returns false if it is not on the screen
+static bool ProjectPlane(const float *modelView, const float *projection, int i, float *x, float *y)
+{
+    double eye[4], clip[4];
+    TransformPoint(modelView, traffic.x[i], traffic.y[i], traffic.z[i], eye);
+    TransformPoint(projection, eye[0], eye[1], eye[2], clip);
+
+    if (clip[3] <= 0.0 || clip[0] < -clip[3] || clip[0] > clip[3] || clip[1] < -clip[3] || clip[1] > clip[3])
+        return false;
+
+    *x = (float) (viewport[0] + (clip[0] / clip[3] + 1.0) * 0.5 * viewport[2]);
+    *y = (float) (viewport[1] + (clip[1] / clip[3] + 1.0) * 0.5 * viewport[3]);
+
+    return true;
+}
+
+// projects the selected planes onto the screen with the current OpenGL matrices for the next layout and moves the placed labels along with their planes, must be called from a 3D draw callback of the main view
+void ProjectLabels(void)
+{
+    float modelView[16], projection[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelView);
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // project all selected planes in one pass over the traffic
+    projectedCount = 0;
+    for (int s = 0; s < selectedCount; s++)
+    {
+        int i = selectedIndices[s];
+        if (!ProjectPlane(modelView, projection, i, &projectedX[projectedCount], &projectedY[projectedCount]))
+            continue;
+
+        projectedSlots[projectedCount] = traffic.slot[i];
+        projectedCount++;
+    }
+    layoutPending = true;
+
+    for (int l = 0; l < labelCount; l++)
+    {
+        Label *label = &labels[l];
+        int i = label->slot != SLOT_NONE ? FindPlane(label->slot) : -1;
+
+        float x = 0.0f, y = 0.0f;
+        label->visible = i != -1 && ProjectPlane(modelView, projection, i, &x, &y);
+        label->x = (int) x - label->width / 2;
+        label->y = (int) y + LABEL_OFFSET;
+    }
+}
+
+// places the labels of the planes of the last projection so that they do not overlap, planes that were labelled by the last layout are placed first so that labels do not flicker, returns 0 because the layout is a single unit of work, must be called from the sim thread
+int LayoutLabels(void)
+{
+    if (!layoutPending)
+        return 0;
+
+    layoutPending = false;
+    labelCount = 0;
+
+    // the grid cells are at least as large as a label, so a label can only overlap labels whose corners lie in the same or a neighboring cell
+    int charWidth = 0, charHeight = 0;
+    XPLMGetFontDimensions(xplmFont_Basic, &charWidth, &charHeight, NULL);
+
+    int cellWidth = charWidth * LABEL_LENGTH, cellHeight = charHeight;
+    if (cellWidth * MAX_GRID_CELLS < viewport[2])
+        cellWidth = viewport[2] / MAX_GRID_CELLS + 1;
+    if (cellHeight * MAX_GRID_CELLS < viewport[3])
+        cellHeight = viewport[3] / MAX_GRID_CELLS + 1;
+    if (cellWidth <= 0 || cellHeight <= 0)
+        return 0;
+
+    int columns = viewport[2] / cellWidth + 1, rows = viewport[3] / cellHeight + 1;
+    for (int c = 0; c < columns * rows; c++)
+        gridCells[c] = -1;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int p = 0; p < projectedCount; p++)
+        {
+            unsigned short slot = projectedSlots[p];
+            if (projectedX[p] < 0.0f || labelled[slot] != (pass == 0))
+                continue;
+
+            labelled[slot] = 0;
+
+            // the plane may have been removed since the projection
+            int i = FindPlane(slot);
+            if (i == -1)
+            {
+                projectedX[p] = -1.0f;
+                continue;
+            }
+
+            // the ICAO flight ID is missing for many general aviation planes, they are labelled with their registration
+            Label *label = &labels[labelCount];
+            snprintf(label->text, sizeof(label->text), "%s %s", strcmp(traffic.identity[i].icaoId, UNKNOWN_ID) != 0 ? traffic.identity[i].icaoId : traffic.identity[i].registration, traffic.identity[i].icaoType);
+            label->slot = slot;
+            label->visible = true;
+            label->width = (int) strlen(label->text) * charWidth;
+            label->x = (int) projectedX[p] - label->width / 2;
+            label->y = (int) projectedY[p] + LABEL_OFFSET;
+
+            int column = (label->x - viewport[0]) / cellWidth, row = (label->y - viewport[1]) / cellHeight;
+            if (column < 0 || column >= columns || row < 0 || row >= rows)
+            {
+                projectedX[p] = -1.0f;
+                continue;
+            }
+
+            bool overlaps = false;
+            for (int r = row - 1; r <= row + 1 && !overlaps; r++)
+            {
+                for (int c = column - 1; c <= column + 1 && !overlaps; c++)
+                {
+                    if (r < 0 || r >= rows || c < 0 || c >= columns)
+                        continue;
+
+                    for (int l = gridCells[r * columns + c]; l != -1 && !overlaps; l = labels[l].next)
+                        overlaps = label->x < labels[l].x + labels[l].width && labels[l].x < label->x + label->width && label->y < labels[l].y + charHeight && labels[l].y < label->y + charHeight;
+                }
+            }
+
+            // a label that does not fit is not tried again in the second pass
+            if (overlaps)
+            {
+                projectedX[p] = -1.0f;
+                continue;
+            }
+
+            label->next = gridCells[row * columns + column];
+            gridCells[row * columns + column] = labelCount;
+            labelled[slot] = 1;
+            slotLabels[slot] = labelCount;
+            labelCount++;
+        }
+    }
+
+    return 0;
+}
+
+// draws the labels that were placed by the last layout at the positions of the last projection, must be called from a 2D draw callback
+void DrawLabels(void)
+{
+    float color[] = {LABEL_COLOR};
+
+    for (int l = 0; l < labelCount; l++)
+    {
+        if (labels[l].visible)
+            XPLMDrawString(color, labels[l].x, labels[l].y, labels[l].text, NULL, xplmFont_Basic);
+    }
+}
+
+// forgets whether the plane in the given stable slot was labelled and hides its label, must be called when the plane is removed so that a plane that reuses the slot is not favored and does not show the old label
+void RemoveLabel(unsigned short slot)
+{
+    // a plane that has left the screen keeps its flag but its label may have been reused by the last layout
+    if (labelled[slot] && slotLabels[slot] < labelCount && labels[slotLabels[slot]].slot == slot)
+        labels[slotLabels[slot]].slot = SLOT_NONE;
+
+    labelled[slot] = 0;
+}
+
+// removes all labels, must be called when the local coordinate system has moved until the labels are projected and placed again
+void ClearLabels(void)
+{
+    labelCount = 0;
+    projectedCount = 0;
+    layoutPending = false;
+}
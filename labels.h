@@ -0,0 +1,37 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef LABELS_H
+#define LABELS_H
+
+// projects the selected planes onto the screen with the current OpenGL matrices for the next layout and moves the placed labels along with their planes, must be called from a 3D draw callback of the main view
+void ProjectLabels(void);
+
+// places the labels of the planes of the last projection so that they do not overlap, planes that were labelled by the last layout are placed first so that labels do not flicker, returns 0 because the layout is a single unit of work, must be called from the sim thread
+int LayoutLabels(void);
+
+// draws the labels that were placed by the last layout at the positions of the last projection, must be called from a 2D draw callback
+void DrawLabels(void);
+
+// forgets whether the plane in the given stable slot was labelled and hides its label, must be called when the plane is removed so that a plane that reuses the slot is not favored and does not show the old label
+void RemoveLabel(unsigned short slot);
+
+// removes all labels, must be called when the local coordinate system has moved until the labels are projected and placed again
+void ClearLabels(void);
+
+#endif
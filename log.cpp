@@ -0,0 +1,213 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "log.h"
+#include "ringbuffer.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// define number of records each log queue can hold, must be a power of two
+#define LOG_QUEUE_SIZE 1024
+
+// define maximum number of messages per category the log thread writes per second, further messages are counted and summarized
+#define LOG_RATE_LIMIT 20
+
+// define intervall in microseconds in which the log thread drains the queues
+#define LOG_INTERVALL 100000
+
+// define log record struct, a message in binary form that is formatted by the log thread
+struct LogRecord
+{
+    unsigned char level;
+    unsigned char category;
+    unsigned char valueCount;
+    bool hasText; // true if text is passed to format, an empty text is still passed
+    const char *format; // string literal, NULL if text is the whole message
+    char text[64];
+    double values[LOG_MAX_VALUES];
+};
+
+// external variables
+int logLevel = LOG_LEVEL_INFO;
+
+// global variables
+static const char *levelNames[] = {"ERROR", "WARNING", "INFO", "DEBUG"};
+static const char *categoryNames[] = {"General", "Network", "Traffic", "Interpolation"};
+static RingBuffer<LogRecord, LOG_QUEUE_SIZE> simQueue; // only written by the sim thread, therefore lock-free
+static RingBuffer<LogRecord, LOG_QUEUE_SIZE> otherQueue; // written by all other threads while holding otherQueueMutex
+static pthread_mutex_t otherQueueMutex;
+static pthread_t simThread, logThread;
+static volatile bool running = false;
+static FILE *file = NULL;
+static unsigned int droppedRecords = 0;
+static time_t rateLimitTime = 0;
+static int rateLimitCounts[LOG_CATEGORY_COUNT];
+static int suppressedCounts[LOG_CATEGORY_COUNT];
+
+// appends a record to the queue of the calling thread, the record is dropped if the queue is full
+static void PushRecord(const LogRecord *record)
+{
+    bool pushed = false;
+
+    if (pthread_equal(pthread_self(), simThread))
+        pushed = simQueue.Push(*record);
+    else
+    {
+        pthread_mutex_lock(&otherQueueMutex);
+        pushed = otherQueue.Push(*record);
+        pthread_mutex_unlock(&otherQueueMutex);
+    }
+
+    if (!pushed)
+        __atomic_fetch_add(&droppedRecords, 1, __ATOMIC_RELAXED);
+}
+
+// writes how many messages of each category have been suppressed and resets the rate limits
+static void ResetRateLimits(void)
+{
+    for (int category = 0; category < LOG_CATEGORY_COUNT; category++)
+    {
+        if (suppressedCounts[category] > 0)
+            fprintf(file, "[%s] %s: %d messages suppressed\n", levelNames[LOG_LEVEL_WARNING], categoryNames[category], suppressedCounts[category]);
+
+        rateLimitCounts[category] = 0;
+        suppressedCounts[category] = 0;
+    }
+}
+
+// formats and writes a single record, if the category has exceeded its rate limit the record is only counted
+static void WriteRecord(const LogRecord *record, time_t currentTime)
+{
+    if (currentTime != rateLimitTime)
+    {
+        ResetRateLimits();
+        rateLimitTime = currentTime;
+    }
+
+    if (rateLimitCounts[record->category]++ >= LOG_RATE_LIMIT)
+    {
+        suppressedCounts[record->category]++;
+        return;
+    }
+
+    char message[1024];
+    const double *v = record->values;
+    if (record->format == NULL)
+        snprintf(message, sizeof(message), "%s", record->text);
+    else if (record->hasText)
+        snprintf(message, sizeof(message), record->format, record->text, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+    else
+        snprintf(message, sizeof(message), record->format, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+
+    fprintf(file, "[%s] %s: %s\n", levelNames[record->level], categoryNames[record->category], message);
+}
+
+// writes all queued records
+static void DrainQueues(void)
+{
+    time_t currentTime = time(NULL);
+    LogRecord record;
+
+    while (simQueue.Pop(&record))
+        WriteRecord(&record, currentTime);
+
+    while (otherQueue.Pop(&record))
+        WriteRecord(&record, currentTime);
+
+    unsigned int dropped = __atomic_exchange_n(&droppedRecords, 0, __ATOMIC_RELAXED);
+    if (dropped > 0)
+        fprintf(file, "[%s] %s: %u messages dropped, queue full\n", levelNames[LOG_LEVEL_WARNING], categoryNames[LOG_CATEGORY_GENERAL], dropped);
+
+    fflush(file);
+}
+
+// thread function that drains the queues in regular intervalls
+static void *LogThreadFunction(void *ptr)
+{
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+    {
+        DrainQueues();
+        usleep(LOG_INTERVALL);
+    }
+
+    DrainQueues();
+    ResetRateLimits();
+
+    return NULL;
+}
+
+// queues a message for the log thread without formatting it, format must be a string literal that takes text as its first %s argument if text is not NULL followed by valueCount double arguments
+void LogValues(int level, int category, const char *format, const char *text, int valueCount, const double *values)
+{
+    if (!LogEnabled(level) || !running)
+        return;
+
+    LogRecord record;
+    record.level = (unsigned char) level;
+    record.category = (unsigned char) category;
+    record.valueCount = (unsigned char) (valueCount < LOG_MAX_VALUES ? valueCount : LOG_MAX_VALUES);
+    record.format = format;
+    record.hasText = text != NULL;
+    record.text[0] = '\0';
+    if (text != NULL)
+    {
+        strncpy(record.text, text, sizeof(record.text) - 1);
+        record.text[sizeof(record.text) - 1] = '\0';
+    }
+    for (int i = 0; i < LOG_MAX_VALUES; i++)
+        record.values[i] = i < record.valueCount ? values[i] : 0.0;
+
+    PushRecord(&record);
+}
+
+// queues a static message for the log thread
+void LogString(int level, int category, const char *message)
+{
+    LogValues(level, category, NULL, message, 0, NULL);
+}
+
+// starts the log thread that formats queued messages and appends them to the file at the given path
+void LogInit(const char *path)
+{
+    file = fopen(path, "w");
+    if (file == NULL)
+        return;
+
+    pthread_mutex_init(&otherQueueMutex, 0);
+    simThread = pthread_self();
+    running = true;
+    pthread_create(&logThread, NULL, LogThreadFunction, NULL);
+}
+
+// writes all queued messages and stops the log thread
+void LogCleanup(void)
+{
+    if (!running)
+        return;
+
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+    pthread_join(logThread, NULL);
+    pthread_mutex_destroy(&otherQueueMutex);
+
+    fclose(file);
+    file = NULL;
+}
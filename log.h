@@ -0,0 +1,59 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef LOG_H
+#define LOG_H
+
+// define log levels
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARNING 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+// define log categories
+#define LOG_CATEGORY_GENERAL 0
+#define LOG_CATEGORY_NETWORK 1
+#define LOG_CATEGORY_TRAFFIC 2
+#define LOG_CATEGORY_INTERPOLATION 3
+#define LOG_CATEGORY_COUNT 4
+
+// define maximum number of values a log record can carry
+#define LOG_MAX_VALUES 8
+
+// external variables
+extern int logLevel; // messages above this level are discarded
+
+// returns true if messages of the given level are currently logged, callers should check this before gathering values so that disabled messages cost nothing but a comparison
+inline static bool LogEnabled(int level)
+{
+    return level <= logLevel;
+}
+
+// queues a message for the log thread without formatting it, format must be a string literal that takes text as its first %s argument if text is not NULL followed by valueCount double arguments
+void LogValues(int level, int category, const char *format, const char *text, int valueCount, const double *values);
+
+// queues a static message for the log thread
+void LogString(int level, int category, const char *message);
+
+// starts the log thread that formats queued messages and appends them to the file at the given path
+void LogInit(const char *path);
+
+// writes all queued messages and stops the log thread
+void LogCleanup(void);
+
+#endif
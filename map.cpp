@@ -0,0 +1,321 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "map.h"
+#include "geodesy.h"
+#include "spatial.h"
+#include "traffic.h"
+#include "XPLMDataAccess.h"
+#include "XPLMDisplay.h"
+#include "XPLMGraphics.h"
+#include "XPLMProcessing.h"
+
+#if APL
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#include <math.h>
+#include <stdio.h>
+
+// define factors
+#define FACTOR_NM_TO_METERS 1852.0
+
+// define initial geometry of the window in pixels
+#define MAP_LEFT 50
+#define MAP_TOP 600
+#define MAP_SIZE 300
+
+// define minimum size of the window in pixels
+#define MIN_MAP_SIZE 150
+
+// define size in pixels of the corner that resizes the window when dragged
+#define RESIZE_HANDLE_SIZE 12
+
+// define initial, minimum and maximum range in nautical miles from the user to the nearest edge of the map
+#define MAP_RANGE 20.0
+#define MIN_MAP_RANGE 1.25
+#define MAX_MAP_RANGE 80.0
+
+// define margin in nautical miles by which the map's query box is enlarged, planes may have moved away from their last reported position
+#define QUERY_MARGIN 5.0
+
+// define length in pixels of the heading line of a plane symbol and of the arms of the user symbol
+#define SYMBOL_LENGTH 10.0f
+
+// define distance in pixels the user may move away from the point the symbols were built around before they are rebuilt, the symbols are only clipped to the edges of the map when they are built
+#define MAX_USER_DRIFT 5.0
+
+// define symbol groups, selected planes are drawn brighter than planes that are only tracked
+#define SYMBOL_GROUP_SELECTED 0
+#define SYMBOL_GROUP_TRACKED 1
+#define SYMBOL_GROUP_COUNT 2
+
+// define symbol group struct, the vertices of all symbols drawn in one color in pixels relative to the position of the user at the last rebuild
+struct SymbolGroup
+{
+    float points[MAX_TRACKED_PLANES * 2];
+    float lines[MAX_TRACKED_PLANES * 4];
+    int count;
+};
+
+// global variables
+static XPLMWindowID window = NULL;
+static XPLMDataRef latitudeDataRef = NULL, longitudeDataRef = NULL, localXDataRef = NULL, localZDataRef = NULL;
+static SymbolGroup groups[SYMBOL_GROUP_COUNT];
+static int queryResults[MAX_TRACKED_PLANES];
+static const float groupColors[SYMBOL_GROUP_COUNT][4] = {{1.0f, 1.0f, 0.9f, 1.0f}, {0.5f, 0.7f, 0.9f, 0.8f}};
+static const float userSymbol[] = {-SYMBOL_LENGTH, 0.0f, SYMBOL_LENGTH, 0.0f, 0.0f, -SYMBOL_LENGTH, 0.0f, SYMBOL_LENGTH};
+static double range = MAP_RANGE;
+static int buildWidth = 0, buildHeight = 0; // size of the window at the last rebuild
+static double anchorX = 0.0, anchorZ = 0.0; // local position of the user at the last rebuild, the symbols stay fixed to the world and are moved by the user's offset from it
+static double buildTime = 0.0; // elapsed sim time at the last rebuild
+static double buildMetersPerPixel = 1.0; // scale of the map at the last rebuild
+static double maxSymbolSpeed = 0.0; // fastest plane near the map at the last rebuild in meters per second
+static bool dirty = true; // set when the view or the planes have changed and the symbols must be rebuilt
+static char rangeText[32];
+static int dragX = 0, dragY = 0; // mouse position at the last drag event
+static bool resizing = false;
+
+// rebuilds the symbols of all planes that lie inside the map, positions are relative to the given position of the user with north up
+static void BuildSymbols(int width, int height, double userX, double userZ)
+{
+    double metersPerPixel = range * FACTOR_NM_TO_METERS / ((width < height ? width : height) / 2.0);
+    double halfWidth = width / 2.0 * metersPerPixel, halfHeight = height / 2.0 * metersPerPixel;
+
+    for (int g = 0; g < SYMBOL_GROUP_COUNT; g++)
+        groups[g].count = 0;
+    maxSymbolSpeed = 0.0;
+
+    // only the planes near the map are looked at, the box is enlarged so that planes that moved into the map since their last report are found
+    double latitude = XPLMGetDatad(latitudeDataRef), longitude = XPLMGetDatad(longitudeDataRef);
+    double latitudeSpan = halfHeight / FACTOR_NM_TO_METERS / 60.0 + QUERY_MARGIN / 60.0;
+    double longitudeSpan = (halfWidth / FACTOR_NM_TO_METERS + QUERY_MARGIN) / (60.0 * fmax(cos(DegreesToRadians(latitude)), 0.01));
+    int count = QueryBox(latitude - latitudeSpan, longitude - longitudeSpan, latitude + latitudeSpan, longitude + longitudeSpan, queryResults, MAX_TRACKED_PLANES);
+
+    for (int q = 0; q < count; q++)
+    {
+        int i = queryResults[q];
+
+        // planes outside the map count as well, they may move into it before the next rebuild
+        double speed = sqrt((double) traffic.velocityX[i] * traffic.velocityX[i] + (double) traffic.velocityZ[i] * traffic.velocityZ[i]);
+        if (speed > maxSymbolSpeed)
+            maxSymbolSpeed = speed;
+
+        double dX = traffic.x[i] - userX, dZ = traffic.z[i] - userZ;
+        if (dX < -halfWidth || dX > halfWidth || dZ < -halfHeight || dZ > halfHeight)
+            continue;
+
+        // north is along -Z and the map's Y axis points up
+        SymbolGroup *group = &groups[traffic.selected[i] ? SYMBOL_GROUP_SELECTED : SYMBOL_GROUP_TRACKED];
+        float x = (float) (dX / metersPerPixel), y = (float) (-dZ / metersPerPixel);
+        float heading = (float) DegreesToRadians(traffic.interpolatedHeading[i]);
+
+        group->points[group->count * 2] = x;
+        group->points[group->count * 2 + 1] = y;
+        group->lines[group->count * 4] = x;
+        group->lines[group->count * 4 + 1] = y;
+        group->lines[group->count * 4 + 2] = x + SYMBOL_LENGTH * sinf(heading);
+        group->lines[group->count * 4 + 3] = y + SYMBOL_LENGTH * cosf(heading);
+        group->count++;
+    }
+
+    snprintf(rangeText, sizeof(rangeText), "%.4g NM", range);
+
+    buildWidth = width;
+    buildHeight = height;
+    anchorX = userX;
+    anchorZ = userZ;
+    buildTime = XPLMGetElapsedTime();
+    buildMetersPerPixel = metersPerPixel;
+    dirty = false;
+}
+
+// window-callback that draws the map, the symbols are only rebuilt when the view has changed or the planes have moved by more than a pixel, otherwise every group is drawn from its cached vertices with two calls and moved by the user's offset from the position it was built around
+static void DrawMapCallback(XPLMWindowID inWindowID, void *inRefcon)
+{
+    int left = 0, top = 0, right = 0, bottom = 0;
+    XPLMGetWindowGeometry(inWindowID, &left, &top, &right, &bottom);
+    XPLMDrawTranslucentDarkBox(left, top, right, bottom);
+
+    // north is along -Z and the map's Y axis points up
+    double userX = XPLMGetDatad(localXDataRef), userZ = XPLMGetDatad(localZDataRef);
+    double offsetX = (anchorX - userX) / buildMetersPerPixel, offsetY = (userZ - anchorZ) / buildMetersPerPixel;
+    bool planesMoved = (XPLMGetElapsedTime() - buildTime) * maxSymbolSpeed > buildMetersPerPixel;
+    bool userMoved = offsetX * offsetX + offsetY * offsetY > MAX_USER_DRIFT * MAX_USER_DRIFT;
+
+    int width = right - left, height = top - bottom;
+    if (dirty || planesMoved || userMoved || width != buildWidth || height != buildHeight)
+    {
+        BuildSymbols(width, height, userX, userZ);
+        offsetX = 0.0;
+        offsetY = 0.0;
+    }
+
+    XPLMSetGraphicsState(0, 0, 0, 0, 1, 0, 0);
+    glPushMatrix();
+    glTranslatef((left + right) / 2.0f, (top + bottom) / 2.0f, 0.0f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+
+    glPushMatrix();
+    glTranslatef((float) offsetX, (float) offsetY, 0.0f);
+
+    for (int g = SYMBOL_GROUP_COUNT - 1; g >= 0; g--)
+    {
+        if (groups[g].count == 0)
+            continue;
+
+        glColor4fv(groupColors[g]);
+        glVertexPointer(2, GL_FLOAT, 0, groups[g].lines);
+        glDrawArrays(GL_LINES, 0, groups[g].count * 2);
+        glPointSize(3.0f);
+        glVertexPointer(2, GL_FLOAT, 0, groups[g].points);
+        glDrawArrays(GL_POINTS, 0, groups[g].count);
+    }
+
+    glPopMatrix();
+
+    glColor4fv(groupColors[SYMBOL_GROUP_SELECTED]);
+    glVertexPointer(2, GL_FLOAT, 0, userSymbol);
+    glDrawArrays(GL_LINES, 0, 4);
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glPopMatrix();
+
+    float color[] = {1.0f, 1.0f, 1.0f};
+    XPLMDrawString(color, left + 5, top - 15, rangeText, NULL, xplmFont_Basic);
+}
+
+// window-callback for keys, the map does not take keyboard input
+static void HandleMapKeyCallback(XPLMWindowID inWindowID, char inKey, XPLMKeyFlags inFlags, char inVirtualKey, void *inRefcon, int losingFocus)
+{
+}
+
+// window-callback that moves the window when it is dragged and resizes it when its lower right corner is dragged
+static int HandleMapMouseCallback(XPLMWindowID inWindowID, int x, int y, XPLMMouseStatus inMouse, void *inRefcon)
+{
+    int left = 0, top = 0, right = 0, bottom = 0;
+    XPLMGetWindowGeometry(inWindowID, &left, &top, &right, &bottom);
+
+    if (inMouse == xplm_MouseDown)
+        resizing = x >= right - RESIZE_HANDLE_SIZE && y <= bottom + RESIZE_HANDLE_SIZE;
+    else if (inMouse == xplm_MouseDrag)
+    {
+        int dX = x - dragX, dY = y - dragY;
+
+        if (resizing)
+        {
+            right = right + dX < left + MIN_MAP_SIZE ? left + MIN_MAP_SIZE : right + dX;
+            bottom = bottom + dY > top - MIN_MAP_SIZE ? top - MIN_MAP_SIZE : bottom + dY;
+        }
+        else
+        {
+            left += dX;
+            right += dX;
+            top += dY;
+            bottom += dY;
+        }
+
+        XPLMSetWindowGeometry(inWindowID, left, top, right, bottom);
+    }
+
+    dragX = x;
+    dragY = y;
+
+    return 1;
+}
+
+// window-callback for the cursor, X-Plane's default cursor is used
+static XPLMCursorStatus HandleMapCursorCallback(XPLMWindowID inWindowID, int x, int y, void *inRefcon)
+{
+    return xplm_CursorDefault;
+}
+
+// window-callback that zooms the map by a factor of two per click of the mouse wheel
+static int HandleMapMouseWheelCallback(XPLMWindowID inWindowID, int x, int y, int wheel, int clicks, void *inRefcon)
+{
+    if (wheel != 0)
+        return 1;
+
+    for (; clicks > 0 && range / 2.0 >= MIN_MAP_RANGE; clicks--)
+        range /= 2.0;
+    for (; clicks < 0 && range * 2.0 <= MAX_MAP_RANGE; clicks++)
+        range *= 2.0;
+
+    dirty = true;
+
+    return 1;
+}
+
+// creates the hidden moving map window that shows all tracked planes around the user
+void InitMap(void)
+{
+    latitudeDataRef = XPLMFindDataRef("sim/flightmodel/position/latitude");
+    longitudeDataRef = XPLMFindDataRef("sim/flightmodel/position/longitude");
+    localXDataRef = XPLMFindDataRef("sim/flightmodel/position/local_x");
+    localZDataRef = XPLMFindDataRef("sim/flightmodel/position/local_z");
+
+    XPLMCreateWindow_t params;
+    params.structSize = sizeof(params);
+    params.left = MAP_LEFT;
+    params.top = MAP_TOP;
+    params.right = MAP_LEFT + MAP_SIZE;
+    params.bottom = MAP_TOP - MAP_SIZE;
+    params.visible = 0;
+    params.drawWindowFunc = DrawMapCallback;
+    params.handleMouseClickFunc = HandleMapMouseCallback;
+    params.handleKeyFunc = HandleMapKeyCallback;
+    params.handleCursorFunc = HandleMapCursorCallback;
+    params.handleMouseWheelFunc = HandleMapMouseWheelCallback;
+    params.refcon = NULL;
+
+    window = XPLMCreateWindowEx(&params);
+}
+
+// returns 1 if the moving map window is visible
+int IsMapVisible(void)
+{
+    return window != NULL && XPLMGetWindowIsVisible(window);
+}
+
+// shows or hides the moving map window
+void ShowMap(int visible)
+{
+    if (window == NULL)
+        return;
+
+    XPLMSetWindowIsVisible(window, visible);
+    dirty = true;
+}
+
+// forces the map to be rebuilt in the next frame, must be called when reports have been applied to the planes or the local coordinate system has moved
+void InvalidateMap(void)
+{
+    dirty = true;
+}
+
+// destroys the moving map window
+void CleanupMap(void)
+{
+    if (window == NULL)
+        return;
+
+    XPLMDestroyWindow(window);
+    window = NULL;
+}
@@ -0,0 +1,37 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MAP_H
+#define MAP_H
+
+// creates the hidden moving map window that shows all tracked planes around the user
+void InitMap(void);
+
+// returns 1 if the moving map window is visible
+int IsMapVisible(void);
+
+// shows or hides the moving map window
+void ShowMap(int visible);
+
+// forces the map to be rebuilt in the next frame, must be called when reports have been applied to the planes or the local coordinate system has moved
+void InvalidateMap(void);
+
+// destroys the moving map window
+void CleanupMap(void);
+
+#endif
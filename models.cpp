@@ -0,0 +1,421 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "models.h"
+#include "log.h"
+#include "scheduler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// define maximum number of entries of the model file
+#define MAX_MODEL_MAPPINGS 256
+
+// define maximum number of aircraft entries of the model file
+#define MAX_AIRCRAFT_MAPPINGS 64
+
+// define number of entries of the aircraft type cache, must be a power of two
+#define TYPE_CACHE_SIZE 1024
+
+// define time in seconds after which a model that no visible plane uses is unloaded
+#define MODEL_UNLOAD_DELAY 60.0
+
+// define index of the placeholder model, it is never unloaded
+#define PLACEHOLDER_MODEL 0
+
+// define model states
+#define MODEL_UNLOADED 0
+#define MODEL_QUEUED 1
+#define MODEL_LOADING 2
+#define MODEL_LOADED 3
+#define MODEL_FAILED 4
+
+// define model struct
+struct Model
+{
+    char path[256]; // relative to the X-Plane folder
+    XPLMObjectRef object;
+    int state; // one of the MODEL_* states
+    int referenceCount; // number of visible planes that use the model in the current frame
+    double lastUsed; // elapsed sim time in seconds at which a visible plane last used the model
+    long long requestTime; // microseconds, time at which the model was queued for loading
+};
+
+// define model mapping struct, an entry of the model file
+struct ModelMapping
+{
+    char type[5]; // ICAO aircraft type or prefix of it, * matches all types
+    int model;
+};
+
+// define aircraft mapping struct, an @acf entry of the model file
+struct AircraftMapping
+{
+    char type[5]; // ICAO aircraft type or prefix of it, * matches all types
+    char path[256]; // aircraft file relative to the X-Plane folder
+};
+
+// define type cache entry struct, the resolved model of an ICAO aircraft type
+struct TypeCacheEntry
+{
+    char type[5]; // empty if the entry is unused
+    int model;
+};
+
+// global variables
+static Model models[MAX_MODELS];
+static int modelCount = 0;
+static ModelMapping mappings[MAX_MODEL_MAPPINGS];
+static int mappingCount = 0;
+static AircraftMapping aircraftMappings[MAX_AIRCRAFT_MAPPINGS];
+static int aircraftMappingCount = 0;
+static TypeCacheEntry typeCache[TYPE_CACHE_SIZE];
+static int loadQueue[MAX_MODELS]; // models waiting to be loaded, every model is queued at most once
+static int loadQueueStart = 0, loadQueueCount = 0;
+static int proxyModel = -1; // low detail model for planes of medium projected size, -1 if there is none
+static int unloadCursor = 1; // model at which the search for unused models continues
+static double currentTime = 0.0;
+static long long totalLoadLatency = 0, loadCount = 0; // microseconds
+static long long hitCount = 0, missCount = 0;
+
+// returns the model with the given path, adds it if it is not known yet, returns -1 if there are too many models
+static int AddModel(const char *path)
+{
+    for (int m = 0; m < modelCount; m++)
+    {
+        if (strcmp(models[m].path, path) == 0)
+            return m;
+    }
+
+    if (modelCount == MAX_MODELS)
+        return -1;
+
+    Model *model = &models[modelCount];
+    strncpy(model->path, path, sizeof(model->path) - 1);
+    model->path[sizeof(model->path) - 1] = '\0';
+    model->object = NULL;
+    model->state = MODEL_UNLOADED;
+    model->referenceCount = 0;
+    model->lastUsed = 0.0;
+    model->requestTime = 0;
+
+    return modelCount++;
+}
+
+// returns the model that the most specific mapping of the given ICAO aircraft type refers to, mappings to models that failed to load are skipped
+static int ResolveModel(const char *icaoType)
+{
+    size_t length = strlen(icaoType);
+
+    // try the whole type first and then shorter and shorter prefixes, so that e.g. B738 falls back to B73 and then B7
+    for (size_t prefixLength = length; prefixLength > 0; prefixLength--)
+    {
+        for (int i = 0; i < mappingCount; i++)
+        {
+            if (models[mappings[i].model].state != MODEL_FAILED && strlen(mappings[i].type) == prefixLength && strncmp(mappings[i].type, icaoType, prefixLength) == 0)
+                return mappings[i].model;
+        }
+    }
+
+    for (int i = 0; i < mappingCount; i++)
+    {
+        if (models[mappings[i].model].state != MODEL_FAILED && strcmp(mappings[i].type, "*") == 0)
+            return mappings[i].model;
+    }
+
+    return PLACEHOLDER_MODEL;
+}
+
+// queues a model for loading
+static void QueueModel(int model)
+{
+    models[model].state = MODEL_QUEUED;
+    models[model].requestTime = GetMicroseconds();
+    loadQueue[(loadQueueStart + loadQueueCount) % MAX_MODELS] = model;
+    loadQueueCount++;
+}
+
+// callback that is called by X-Plane once a model has been loaded asynchronously
+static void ModelLoadedCallback(XPLMObjectRef object, void *refcon)
+{
+    int m = (int) (long) refcon;
+
+    // the model has been cleared while it was loading
+    if (m >= modelCount || models[m].state != MODEL_LOADING)
+    {
+        if (object != NULL)
+            XPLMUnloadObject(object);
+        return;
+    }
+
+    if (object == NULL)
+    {
+        models[m].state = MODEL_FAILED;
+        LogValues(LOG_LEVEL_ERROR, LOG_CATEGORY_GENERAL, "Model not found: %s", models[m].path, 0, NULL);
+
+        // aircraft types that resolved to the model fall back to the next mapping that has not failed
+        for (int i = 0; i < TYPE_CACHE_SIZE; i++)
+        {
+            if (typeCache[i].type[0] != '\0' && typeCache[i].model == m)
+                typeCache[i].model = ResolveModel(typeCache[i].type);
+        }
+        return;
+    }
+
+    models[m].object = object;
+    models[m].state = MODEL_LOADED;
+
+    totalLoadLatency += GetMicroseconds() - models[m].requestTime;
+    loadCount++;
+}
+
+// returns the model a plane of the given ICAO aircraft type is drawn with, the most specific entry of the model file whose type is a prefix of the aircraft type is used, the placeholder if there is none
+int FindModel(const char *icaoType)
+{
+    unsigned int hash = 5381;
+    for (const char *c = icaoType; *c != '\0'; c++)
+        hash = hash * 33 + (unsigned char) *c;
+
+    for (int probe = 0; probe < TYPE_CACHE_SIZE; probe++)
+    {
+        TypeCacheEntry *entry = &typeCache[(hash + probe) & (TYPE_CACHE_SIZE - 1)];
+
+        if (entry->type[0] == '\0')
+        {
+            strncpy(entry->type, icaoType, sizeof(entry->type) - 1);
+            entry->type[sizeof(entry->type) - 1] = '\0';
+            entry->model = ResolveModel(entry->type);
+            return entry->model;
+        }
+
+        if (strncmp(entry->type, icaoType, sizeof(entry->type) - 1) == 0)
+            return entry->model;
+    }
+
+    return ResolveModel(icaoType);
+}
+
+// returns the aircraft file a multiplayer plane of the given ICAO aircraft type is shown with relative to the X-Plane folder, the most specific @acf entry of the model file whose type is a prefix of the aircraft type is used, NULL if there is none
+const char *FindAircraftModel(const char *icaoType)
+{
+    size_t length = strlen(icaoType);
+
+    for (size_t prefixLength = length; prefixLength > 0; prefixLength--)
+    {
+        for (int i = 0; i < aircraftMappingCount; i++)
+        {
+            if (strlen(aircraftMappings[i].type) == prefixLength && strncmp(aircraftMappings[i].type, icaoType, prefixLength) == 0)
+                return aircraftMappings[i].path;
+        }
+    }
+
+    for (int i = 0; i < aircraftMappingCount; i++)
+    {
+        if (strcmp(aircraftMappings[i].type, "*") == 0)
+            return aircraftMappings[i].path;
+    }
+
+    return NULL;
+}
+
+// resets the reference counts of all models, must be called before the models of the visible planes are acquired
+void BeginModelFrame(void)
+{
+    for (int m = 0; m < modelCount; m++)
+        models[m].referenceCount = 0;
+}
+
+// counts a reference of a visible plane to a model and returns the object it is drawn with, the placeholder is returned and the model is queued for loading if it is not loaded yet, planes whose model failed to load are drawn with the placeholder, returns NULL if neither is available
+XPLMObjectRef AcquireModel(int model)
+{
+    if (model < 0 || model >= modelCount || models[model].state == MODEL_FAILED)
+        model = PLACEHOLDER_MODEL;
+    if (modelCount == 0)
+        return NULL;
+
+    Model *m = &models[model];
+    m->referenceCount++;
+
+    if (m->state == MODEL_LOADED)
+    {
+        hitCount++;
+        return m->object;
+    }
+
+    // a model that is already queued or loading has been counted as a miss when it was queued
+    if (m->state == MODEL_UNLOADED)
+    {
+        missCount++;
+        QueueModel(model);
+    }
+
+    return models[PLACEHOLDER_MODEL].state == MODEL_LOADED ? models[PLACEHOLDER_MODEL].object : NULL;
+}
+
+// counts a reference to the low detail proxy model and returns its object, returns NULL if the model file defines no proxy model or it is not loaded yet
+XPLMObjectRef AcquireProxyModel(void)
+{
+    if (proxyModel == -1)
+        return NULL;
+
+    Model *m = &models[proxyModel];
+    m->referenceCount++;
+
+    if (m->state == MODEL_UNLOADED)
+        QueueModel(proxyModel);
+
+    return m->state == MODEL_LOADED ? m->object : NULL;
+}
+
+// remembers which models were referenced at the given elapsed sim time, must be called after the models of the visible planes have been acquired
+void EndModelFrame(double time)
+{
+    currentTime = time;
+
+    for (int m = 0; m < modelCount; m++)
+    {
+        if (models[m].referenceCount > 0)
+            models[m].lastUsed = time;
+    }
+}
+
+// starts loading the next queued model asynchronously, returns the number of models that are still queued
+int ProcessModelLoads(void)
+{
+    if (loadQueueCount == 0)
+        return 0;
+
+    int m = loadQueue[loadQueueStart];
+    loadQueueStart = (loadQueueStart + 1) % MAX_MODELS;
+    loadQueueCount--;
+
+    models[m].state = MODEL_LOADING;
+    XPLMLoadObjectAsync(models[m].path, ModelLoadedCallback, (void*) (long) m);
+
+    return loadQueueCount;
+}
+
+// unloads the next model that has not been referenced for a while, returns 1 if there may be further models to unload
+int ProcessModelUnloads(void)
+{
+    // every call inspects a single model, the placeholder is skipped
+    if (modelCount <= 1)
+        return 0;
+
+    if (unloadCursor >= modelCount)
+    {
+        unloadCursor = 1;
+        return 0;
+    }
+
+    Model *m = &models[unloadCursor++];
+    if (m->state == MODEL_LOADED && m->referenceCount == 0 && currentTime - m->lastUsed > MODEL_UNLOAD_DELAY)
+    {
+        XPLMUnloadObject(m->object);
+        m->object = NULL;
+        m->state = MODEL_UNLOADED;
+    }
+
+    return 1;
+}
+
+// returns the average time in milliseconds from requesting a model until it is loaded
+float GetModelLoadLatency(void)
+{
+    return loadCount > 0 ? (float) ((double) totalLoadLatency / loadCount / 1000.0) : 0.0f;
+}
+
+// returns the fraction of model references that were served by a loaded model rather than caused a load
+float GetModelCacheHitRate(void)
+{
+    return hitCount + missCount > 0 ? (float) ((double) hitCount / (hitCount + missCount)) : 0.0f;
+}
+
+// reads the model file at configPath and queues the placeholder model at placeholderPath for loading, model paths are relative to the X-Plane folder, the type @proxy defines the low detail proxy model and lines of the form @acf type path define the aircraft files of multiplayer planes
+void InitModels(const char *configPath, const char *placeholderPath)
+{
+    QueueModel(AddModel(placeholderPath));
+
+    // every line of the model file consists of an ICAO aircraft type or a prefix of it and the path of the model, lines starting with # are comments
+    FILE *file = fopen(configPath, "r");
+    if (file == NULL)
+        return;
+
+    char line[512];
+    while (fgets(line, sizeof(line), file) != NULL && mappingCount < MAX_MODEL_MAPPINGS)
+    {
+        char type[16], path[256];
+        if (line[0] == '#' || sscanf(line, "%15s %255[^\r\n]", type, path) != 2)
+            continue;
+
+        if (strcmp(type, "@proxy") == 0)
+        {
+            proxyModel = AddModel(path);
+            continue;
+        }
+
+        if (strcmp(type, "@acf") == 0)
+        {
+            char acfType[16], acfPath[256];
+            if (aircraftMappingCount < MAX_AIRCRAFT_MAPPINGS && sscanf(path, "%15s %255[^\r\n]", acfType, acfPath) == 2 && strlen(acfType) < sizeof(aircraftMappings[0].type))
+            {
+                strcpy(aircraftMappings[aircraftMappingCount].type, acfType);
+                strcpy(aircraftMappings[aircraftMappingCount].path, acfPath);
+                aircraftMappingCount++;
+            }
+            continue;
+        }
+
+        if (strlen(type) >= sizeof(mappings[0].type))
+            continue;
+
+        int model = AddModel(path);
+        if (model == -1)
+        {
+            LogValues(LOG_LEVEL_WARNING, LOG_CATEGORY_GENERAL, "Too many models, ignoring %s", path, 0, NULL);
+            continue;
+        }
+
+        strcpy(mappings[mappingCount].type, type);
+        mappings[mappingCount].model = model;
+        mappingCount++;
+    }
+
+    fclose(file);
+}
+
+// unloads all models and forgets all type mappings
+void ClearModels(void)
+{
+    for (int m = 0; m < modelCount; m++)
+    {
+        if (models[m].state == MODEL_LOADED)
+            XPLMUnloadObject(models[m].object);
+
+        models[m].object = NULL;
+        models[m].state = MODEL_UNLOADED;
+    }
+
+    modelCount = 0;
+    mappingCount = 0;
+    aircraftMappingCount = 0;
+    proxyModel = -1;
+    memset(typeCache, 0, sizeof(typeCache));
+    loadQueueStart = loadQueueCount = 0;
+    unloadCursor = 1;
+}
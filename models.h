@@ -0,0 +1,63 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MODELS_H
+#define MODELS_H
+
+#include "XPLMScenery.h"
+
+// define maximum number of different models
+#define MAX_MODELS 64
+
+// returns the model a plane of the given ICAO aircraft type is drawn with, the most specific entry of the model file whose type is a prefix of the aircraft type is used, the placeholder if there is none
+int FindModel(const char *icaoType);
+
+// returns the aircraft file a multiplayer plane of the given ICAO aircraft type is shown with relative to the X-Plane folder, the most specific @acf entry of the model file whose type is a prefix of the aircraft type is used, NULL if there is none
+const char *FindAircraftModel(const char *icaoType);
+
+// resets the reference counts of all models, must be called before the models of the visible planes are acquired
+void BeginModelFrame(void);
+
+// counts a reference of a visible plane to a model and returns the object it is drawn with, the placeholder is returned and the model is queued for loading if it is not loaded yet, returns NULL if neither is available
+XPLMObjectRef AcquireModel(int model);
+
+// counts a reference to the low detail proxy model and returns its object, returns NULL if the model file defines no proxy model or it is not loaded yet
+XPLMObjectRef AcquireProxyModel(void);
+
+// remembers which models were referenced at the given elapsed sim time, must be called after the models of the visible planes have been acquired
+void EndModelFrame(double time);
+
+// starts loading the next queued model asynchronously, returns the number of models that are still queued
+int ProcessModelLoads(void);
+
+// unloads the next model that has not been referenced for a while, returns 1 if there may be further models to unload
+int ProcessModelUnloads(void);
+
+// returns the average time in milliseconds from requesting a model until it is loaded
+float GetModelLoadLatency(void);
+
+// returns the fraction of model references that were served by a loaded model rather than caused a load
+float GetModelCacheHitRate(void);
+
+// reads the model file at configPath and queues the placeholder model at placeholderPath for loading, model paths are relative to the X-Plane folder, the type @proxy defines the low detail proxy model and lines of the form @acf type path define the aircraft files of multiplayer planes
+void InitModels(const char *configPath, const char *placeholderPath);
+
+// unloads all models and forgets all type mappings
+void ClearModels(void);
+
+#endif
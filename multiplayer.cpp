@@ -0,0 +1,323 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "multiplayer.h"
+#include "log.h"
+#include "models.h"
+#include "spatial.h"
+#include "traffic.h"
+#include "XPLMDataAccess.h"
+#include "XPLMPlanes.h"
+#include "XPLMUtilities.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+// define fraction by which the distance of a plane that already has a slot is reduced when ranking, planes only lose their slot to clearly nearer planes
+#define MULTIPLAYER_HYSTERESIS 0.25
+
+// define number of planes nearest to the user by their reported horizontal position that are ranked for the slots by their 3D distance
+#define MULTIPLAYER_CANDIDATES (4 * MAX_MULTIPLAYER_PLANES)
+
+// define value of an unused slot
+#define SLOT_UNUSED -1
+
+// define multiplayer slot struct
+struct MultiplayerSlot
+{
+    int plane; // stable slot of the plane that is shown in this multiplayer slot, SLOT_UNUSED if there is none
+    char aircraftPath[512]; // aircraft model currently loaded into the slot, empty if X-Plane's default is used
+    char pendingPath[512]; // aircraft model the slot should show, empty if it matches aircraftPath
+    XPLMDataRef xDataRef, yDataRef, zDataRef, pitchDataRef, rollDataRef, headingDataRef;
+};
+
+// define multiplayer candidate struct used for the ranking
+struct MultiplayerCandidate
+{
+    double score;
+    int index;
+
+    bool operator<(const MultiplayerCandidate &other) const
+    {
+        return score < other.score;
+    }
+};
+
+// global variables
+static MultiplayerSlot slots[MAX_MULTIPLAYER_PLANES + 1]; // index 0 is the user's plane and is never used
+static int slotCount = 0; // number of usable slots after the user's plane
+static bool acquired = false;
+static int planeSlots[MAX_TRACKED_PLANES]; // multiplayer slot of each stable plane slot, SLOT_UNUSED if it has none
+static MultiplayerCandidate candidates[MULTIPLAYER_CANDIDATES + MAX_MULTIPLAYER_PLANES]; // the nearest planes and the planes that already have a slot
+static int nearestPlanes[MULTIPLAYER_CANDIDATES];
+static int pendingModelCursor = 1;
+
+// callback that is called when another plugin gives up the multiplayer planes
+static void PlanesAvailableCallback(void *inRefcon)
+{
+    AcquireMultiplayerPlanes();
+}
+
+// finds the multiplayer datarefs
+void InitMultiplayer(void)
+{
+    for (int s = 1; s <= MAX_MULTIPLAYER_PLANES; s++)
+    {
+        char name[64];
+        MultiplayerSlot *slot = &slots[s];
+
+        sprintf(name, "sim/multiplayer/position/plane%d_x", s);
+        slot->xDataRef = XPLMFindDataRef(name);
+        sprintf(name, "sim/multiplayer/position/plane%d_y", s);
+        slot->yDataRef = XPLMFindDataRef(name);
+        sprintf(name, "sim/multiplayer/position/plane%d_z", s);
+        slot->zDataRef = XPLMFindDataRef(name);
+        sprintf(name, "sim/multiplayer/position/plane%d_the", s);
+        slot->pitchDataRef = XPLMFindDataRef(name);
+        sprintf(name, "sim/multiplayer/position/plane%d_phi", s);
+        slot->rollDataRef = XPLMFindDataRef(name);
+        sprintf(name, "sim/multiplayer/position/plane%d_psi", s);
+        slot->headingDataRef = XPLMFindDataRef(name);
+
+        slot->plane = SLOT_UNUSED;
+        slot->aircraftPath[0] = '\0';
+        slot->pendingPath[0] = '\0';
+    }
+
+    for (int p = 0; p < MAX_TRACKED_PLANES; p++)
+        planeSlots[p] = SLOT_UNUSED;
+}
+
+// tries to acquire exclusive access to the multiplayer planes, if another plugin holds them access is requested again once they are released
+void AcquireMultiplayerPlanes(void)
+{
+    if (acquired || !XPLMAcquirePlanes(NULL, PlanesAvailableCallback, NULL))
+        return;
+
+    int total = 0, active = 0;
+    XPLMPluginID controller = XPLM_NO_PLUGIN_ID;
+    XPLMCountAircraft(&total, &active, &controller);
+
+    slotCount = std::min(total - 1, MAX_MULTIPLAYER_PLANES);
+    if (slotCount < 0)
+        slotCount = 0;
+
+    XPLMSetActiveAircraftCount(slotCount + 1);
+    for (int s = 1; s <= slotCount; s++)
+        XPLMDisableAIForPlane(s);
+
+    acquired = true;
+    LogString(LOG_LEVEL_INFO, LOG_CATEGORY_GENERAL, "Multiplayer planes acquired");
+}
+
+// frees a multiplayer slot
+static void FreeSlot(int s)
+{
+    if (slots[s].plane != SLOT_UNUSED)
+    {
+        planeSlots[slots[s].plane] = SLOT_UNUSED;
+
+        int i = FindPlane((unsigned short) slots[s].plane);
+        if (i != -1)
+            traffic.multiplayer[i] = 0;
+    }
+
+    slots[s].plane = SLOT_UNUSED;
+    slots[s].pendingPath[0] = '\0';
+}
+
+// assigns the selected planes nearest to the user to the multiplayer slots and writes their positions, the candidates are found in the spatial index and ranked by their 3D distance, planes keep their slot until another plane is clearly nearer, must be called from the sim thread
+void UpdateMultiplayer(double userLatitude, double userLongitude, double userX, double userY, double userZ)
+{
+    if (!acquired)
+        return;
+
+    // free the slots of planes that are no longer tracked or selected
+    for (int s = 1; s <= slotCount; s++)
+    {
+        if (slots[s].plane == SLOT_UNUSED)
+            continue;
+
+        int i = FindPlane((unsigned short) slots[s].plane);
+        if (i == -1 || !traffic.selected[i])
+            FreeSlot(s);
+    }
+
+    // the planes that already have a slot are ranked together with the selected planes that are nearest by their reported horizontal position
+    int candidateCount = 0;
+    for (int s = 1; s <= slotCount; s++)
+    {
+        if (slots[s].plane != SLOT_UNUSED)
+            candidates[candidateCount++].index = FindPlane((unsigned short) slots[s].plane);
+    }
+
+    int nearestCount = QueryNearest(userLatitude, userLongitude, MULTIPLAYER_CANDIDATES, nearestPlanes);
+    for (int n = 0; n < nearestCount; n++)
+    {
+        int i = nearestPlanes[n];
+        if (traffic.selected[i] && planeSlots[traffic.slot[i]] == SLOT_UNUSED)
+            candidates[candidateCount++].index = i;
+    }
+
+    // rank the candidates by their distance, planes that already have a slot are favored
+    for (int c = 0; c < candidateCount; c++)
+    {
+        int i = candidates[c].index;
+        double dX = traffic.x[i] - userX, dY = traffic.y[i] - userY, dZ = traffic.z[i] - userZ;
+        double distance = dX * dX + dY * dY + dZ * dZ;
+
+        if (planeSlots[traffic.slot[i]] != SLOT_UNUSED)
+            distance *= (1.0 - MULTIPLAYER_HYSTERESIS) * (1.0 - MULTIPLAYER_HYSTERESIS);
+
+        candidates[c].score = distance;
+    }
+
+    int count = std::min(slotCount, candidateCount);
+    if (count < candidateCount)
+        std::nth_element(candidates, candidates + count, candidates + candidateCount);
+
+    // planes that dropped out of the nearest set give up their slot
+    for (int c = count; c < candidateCount; c++)
+    {
+        int s = planeSlots[traffic.slot[candidates[c].index]];
+        if (s != SLOT_UNUSED)
+            FreeSlot(s);
+    }
+
+    // planes that entered the nearest set take a free slot, the aircraft model is only reloaded if it differs from the one the slot already shows
+    int freeSlot = 1;
+    for (int c = 0; c < count; c++)
+    {
+        int i = candidates[c].index;
+        int s = planeSlots[traffic.slot[i]];
+
+        if (s == SLOT_UNUSED)
+        {
+            while (freeSlot <= slotCount && slots[freeSlot].plane != SLOT_UNUSED)
+                freeSlot++;
+            if (freeSlot > slotCount)
+                break;
+
+            s = freeSlot;
+            slots[s].plane = traffic.slot[i];
+            planeSlots[traffic.slot[i]] = s;
+
+            const char *path = FindAircraftModel(traffic.identity[i].icaoType);
+            if (path != NULL)
+            {
+                char fullPath[512];
+                XPLMGetSystemPath(fullPath);
+                strncat(fullPath, path, sizeof(fullPath) - strlen(fullPath) - 1);
+
+                if (strcmp(fullPath, slots[s].aircraftPath) != 0)
+                    strcpy(slots[s].pendingPath, fullPath);
+            }
+        }
+
+        traffic.multiplayer[i] = 1;
+
+        XPLMSetDatad(slots[s].xDataRef, traffic.x[i]);
+        XPLMSetDatad(slots[s].yDataRef, traffic.y[i]);
+        XPLMSetDatad(slots[s].zDataRef, traffic.z[i]);
+        XPLMSetDataf(slots[s].pitchDataRef, traffic.pitch[i]);
+        XPLMSetDataf(slots[s].rollDataRef, traffic.roll[i]);
+        XPLMSetDataf(slots[s].headingDataRef, traffic.interpolatedHeading[i]);
+    }
+
+    // park the unused planes out of sight
+    for (int s = 1; s <= slotCount; s++)
+    {
+        if (slots[s].plane == SLOT_UNUSED)
+            XPLMSetDatad(slots[s].yDataRef, PARKING_Y);
+    }
+}
+
+// frees the multiplayer slot of the plane in the given stable slot, must be called when the plane is removed so that a plane that reuses the slot does not inherit its multiplayer slot and aircraft model
+void RemoveMultiplayerPlane(unsigned short slot)
+{
+    int s = planeSlots[slot];
+    if (s == SLOT_UNUSED)
+        return;
+
+    FreeSlot(s);
+    XPLMSetDatad(slots[s].yDataRef, PARKING_Y);
+}
+
+// loads the aircraft model of the next slot whose plane has changed its aircraft type, returns the number of slots that still wait for their model
+int ProcessMultiplayerModels(void)
+{
+    if (!acquired)
+        return 0;
+
+    int pending = 0;
+    for (int n = 0; n < slotCount; n++)
+    {
+        int s = pendingModelCursor;
+        pendingModelCursor = pendingModelCursor % slotCount + 1;
+
+        if (slots[s].pendingPath[0] == '\0')
+            continue;
+
+        if (pending == 0)
+        {
+            XPLMSetAircraftModel(s, slots[s].pendingPath);
+            XPLMDisableAIForPlane(s);
+            strcpy(slots[s].aircraftPath, slots[s].pendingPath);
+            slots[s].pendingPath[0] = '\0';
+        }
+
+        pending++;
+    }
+
+    return pending > 0 ? pending - 1 : 0;
+}
+
+// returns the number of multiplayer slots that can be used, 0 if the multiplayer planes are not acquired
+int GetMultiplayerSlotCount(void)
+{
+    return acquired ? slotCount : 0;
+}
+
+// returns the index of the plane that is shown in the given multiplayer slot, -1 if the slot is unused
+int GetMultiplayerPlane(int slot)
+{
+    if (!acquired || slot < 1 || slot > slotCount || slots[slot].plane == SLOT_UNUSED)
+        return -1;
+
+    return FindPlane((unsigned short) slots[slot].plane);
+}
+
+// gives up access to the multiplayer planes
+void ReleaseMultiplayerPlanes(void)
+{
+    if (!acquired)
+        return;
+
+    for (int s = 1; s <= slotCount; s++)
+    {
+        FreeSlot(s);
+        slots[s].aircraftPath[0] = '\0';
+    }
+
+    for (int i = 0; i < traffic.count; i++)
+        traffic.multiplayer[i] = 0;
+
+    XPLMReleasePlanes();
+    acquired = false;
+}
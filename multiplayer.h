@@ -0,0 +1,52 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MULTIPLAYER_H
+#define MULTIPLAYER_H
+
+// define maximum number of multiplayer slots that are used, X-Plane has at most 19 besides the user's plane
+#define MAX_MULTIPLAYER_PLANES 19
+
+// define position far below the terrain where unused multiplayer planes are parked, OpenGL local coordinates in meters
+#define PARKING_Y -100000.0
+
+// finds the multiplayer datarefs
+void InitMultiplayer(void);
+
+// tries to acquire exclusive access to the multiplayer planes, if another plugin holds them access is requested again once they are released
+void AcquireMultiplayerPlanes(void);
+
+// assigns the selected planes nearest to the user to the multiplayer slots and writes their positions, the candidates are found in the spatial index and ranked by their 3D distance, planes keep their slot until another plane is clearly nearer, must be called from the sim thread
+void UpdateMultiplayer(double userLatitude, double userLongitude, double userX, double userY, double userZ);
+
+// frees the multiplayer slot of the plane in the given stable slot, must be called when the plane is removed so that a plane that reuses the slot does not inherit its multiplayer slot and aircraft model
+void RemoveMultiplayerPlane(unsigned short slot);
+
+// loads the aircraft model of the next slot whose plane has changed its aircraft type, returns the number of slots that still wait for their model
+int ProcessMultiplayerModels(void);
+
+// returns the number of multiplayer slots that can be used, 0 if the multiplayer planes are not acquired
+int GetMultiplayerSlotCount(void);
+
+// returns the index of the plane that is shown in the given multiplayer slot, -1 if the slot is unused
+int GetMultiplayerPlane(int slot);
+
+// gives up access to the multiplayer planes
+void ReleaseMultiplayerPlanes(void);
+
+#endif
@@ -0,0 +1,63 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+// bounded lock-free ring buffer for exactly one producer thread and one consumer thread, size must be a power of two
+template <typename T, unsigned int SIZE>
+class RingBuffer
+{
+public:
+    RingBuffer() : head(0), tail(0)
+    {
+    }
+
+    // appends an element, returns false without blocking if the buffer is full, must only be called by the producer
+    bool Push(const T &element)
+    {
+        unsigned int t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+        if (t - __atomic_load_n(&head, __ATOMIC_ACQUIRE) == SIZE)
+            return false;
+
+        elements[t & (SIZE - 1)] = element;
+        __atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+
+        return true;
+    }
+
+    // removes the oldest element, returns false without blocking if the buffer is empty, must only be called by the consumer
+    bool Pop(T *element)
+    {
+        unsigned int h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        if (h == __atomic_load_n(&tail, __ATOMIC_ACQUIRE))
+            return false;
+
+        *element = elements[h & (SIZE - 1)];
+        __atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+
+        return true;
+    }
+
+private:
+    T elements[SIZE];
+    unsigned int head; // index of the next element to pop, only written by the consumer
+    char padding[64]; // keeps head and tail on separate cache lines
+    unsigned int tail; // index of the next element to push, only written by the producer
+};
+
+#endif
@@ -0,0 +1,108 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "scheduler.h"
+
+#if APL
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+// define maximum number of tasks per priority
+#define MAX_TASKS 8
+
+// define task struct
+struct Task
+{
+    TaskFunction function;
+    void *context;
+};
+
+// global variables
+static Task tasks[TASK_PRIORITY_COUNT][MAX_TASKS];
+static int taskCounts[TASK_PRIORITY_COUNT];
+
+// returns the time of a monotonic clock in microseconds
+long long GetMicroseconds(void)
+{
+#if APL
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0)
+        mach_timebase_info(&timebase);
+
+    return (long long) (mach_absolute_time() * timebase.numer / timebase.denom / 1000);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+// adds a deferrable task that is run every frame while the frame budget lasts
+void RegisterTask(int priority, TaskFunction function, void *context)
+{
+    if (taskCounts[priority] == MAX_TASKS)
+        return;
+
+    Task *task = &tasks[priority][taskCounts[priority]++];
+    task->function = function;
+    task->context = context;
+}
+
+// runs the registered tasks by priority until they have no more work or budget microseconds have passed since frameStart, must be called from the sim thread
+void RunTasks(long long frameStart, int budget)
+{
+    bool progressed = false; // at least one unit of work is done per frame so that the queues cannot starve if the mandatory work alone exceeds the budget
+
+    for (int priority = 0; priority < TASK_PRIORITY_COUNT; priority++)
+    {
+        // the tasks of one priority take turns so that none of them starves the others
+        bool pending[MAX_TASKS];
+        for (int i = 0; i < taskCounts[priority]; i++)
+            pending[i] = true;
+
+        bool anyPending = true;
+        while (anyPending)
+        {
+            anyPending = false;
+
+            for (int i = 0; i < taskCounts[priority]; i++)
+            {
+                if (!pending[i])
+                    continue;
+
+                if (progressed && GetMicroseconds() - frameStart >= budget)
+                    return;
+
+                Task *task = &tasks[priority][i];
+                pending[i] = task->function(task->context) != 0;
+                progressed = true;
+                anyPending |= pending[i];
+            }
+        }
+    }
+}
+
+// removes all registered tasks
+void ClearTasks(void)
+{
+    for (int priority = 0; priority < TASK_PRIORITY_COUNT; priority++)
+        taskCounts[priority] = 0;
+}
@@ -0,0 +1,43 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// define task priorities, tasks of a higher priority are run first
+#define TASK_PRIORITY_HIGH 0
+#define TASK_PRIORITY_NORMAL 1
+#define TASK_PRIORITY_LOW 2
+#define TASK_PRIORITY_COUNT 3
+
+// define function type of a deferrable task, performs one small unit of work and returns 0 if there is no more work to do in this frame
+typedef int (*TaskFunction)(void *context);
+
+// returns the time of a monotonic clock in microseconds
+long long GetMicroseconds(void);
+
+// adds a deferrable task that is run every frame while the frame budget lasts
+void RegisterTask(int priority, TaskFunction function, void *context);
+
+// runs the registered tasks by priority until they have no more work or budget microseconds have passed since frameStart, must be called from the sim thread
+void RunTasks(long long frameStart, int budget);
+
+// removes all registered tasks
+void ClearTasks(void);
+
+#endif
@@ -0,0 +1,112 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "selection.h"
+#include "traffic.h"
+#include "workers.h"
+
+#include <algorithm>
+#include <math.h>
+
+// define factors
+#define FACTOR_FEET_TO_METERS 0.3048
+
+// define weights of the relevance score, the score is an equivalent distance in meters and lower is more relevant
+#define ALTITUDE_DIFFERENCE_WEIGHT 3.0 // meters of distance one meter of altitude difference is worth
+#define CLOSURE_HORIZON 60.0 // seconds, a closing plane is scored by its distance after this time
+#define SELECTION_HYSTERESIS 1852.0 // meters, bonus for planes that are already selected
+
+// define number of planes that are scored per worker chunk
+#define SCORING_CHUNK_SIZE 512
+
+// define candidate struct used for the selection
+struct Candidate
+{
+    double score;
+    int index;
+
+    bool operator<(const Candidate &other) const
+    {
+        return score < other.score;
+    }
+};
+
+// define user state struct, the reference the planes are scored against
+struct UserState
+{
+    double x; // OpenGL local coordinates in meters
+    double z;
+    double altitude; // meters MSL
+    double velocityX; // OpenGL local velocity in meters per second
+    double velocityZ;
+};
+
+// external variables
+int selectedIndices[MAX_TRACKED_PLANES];
+int selectedCount = 0;
+
+// global variables
+static Candidate candidates[MAX_TRACKED_PLANES];
+
+// scores the planes from begin to end exclusive against the user state that context points to, runs on the worker threads
+static void ScoreRange(int begin, int end, void *context)
+{
+    const UserState *user = (const UserState*) context;
+
+    for (int i = begin; i < end; i++)
+    {
+        double dX = traffic.x[i] - user->x;
+        double dZ = traffic.z[i] - user->z;
+        double distance = sqrt(dX * dX + dZ * dZ);
+
+        double closureRate = 0.0; // meters per second, positive if closing
+        if (distance > 0.0)
+            closureRate = -(dX * (traffic.velocityX[i] - user->velocityX) + dZ * (traffic.velocityZ[i] - user->velocityZ)) / distance;
+
+        double score = distance + ALTITUDE_DIFFERENCE_WEIGHT * fabs(traffic.interpolatedAltitude[i] * FACTOR_FEET_TO_METERS - user->altitude);
+        if (closureRate > 0.0)
+            score -= std::min(closureRate * CLOSURE_HORIZON, distance);
+        if (traffic.selected[i])
+            score -= SELECTION_HYSTERESIS;
+
+        candidates[i].score = score;
+        candidates[i].index = i;
+    }
+}
+
+// selects the maxPlanes most relevant planes by their distance, closure rate and altitude difference to the user, planes that were selected before are favored to avoid flickering
+void SelectPlanes(int maxPlanes, double userX, double userZ, double userAltitude, double userVelocityX, double userVelocityZ)
+{
+    UserState user;
+    user.x = userX;
+    user.z = userZ;
+    user.altitude = userAltitude;
+    user.velocityX = userVelocityX;
+    user.velocityZ = userVelocityZ;
+    ParallelFor(traffic.count, SCORING_CHUNK_SIZE, ScoreRange, &user);
+
+    selectedCount = std::max(0, std::min(maxPlanes, traffic.count));
+    if (selectedCount < traffic.count)
+        std::nth_element(candidates, candidates + selectedCount, candidates + traffic.count);
+
+    for (int i = 0; i < traffic.count; i++)
+        traffic.selected[candidates[i].index] = i < selectedCount;
+
+    for (int i = 0; i < selectedCount; i++)
+        selectedIndices[i] = candidates[i].index;
+}
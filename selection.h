@@ -0,0 +1,31 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include "api.h"
+
+// external variables
+extern int selectedIndices[MAX_TRACKED_PLANES]; // traffic indices of the selected planes in no particular order
+extern int selectedCount;
+
+// selects the maxPlanes most relevant planes by their distance, closure rate and altitude difference to the user, planes that were selected before are favored to avoid flickering
+void SelectPlanes(int maxPlanes, double userX, double userZ, double userAltitude, double userVelocityX, double userVelocityZ);
+
+#endif
@@ -0,0 +1,317 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "spatial.h"
+#include "geodesy.h"
+#include "traffic.h"
+
+#include <algorithm>
+#include <math.h>
+
+// define size in degrees of a grid cell, about six nautical miles in latitude
+#define GRID_CELL_SIZE 0.1
+
+// define number of grid cells around a circle of latitude, cell coordinates of longitudes are wrapped into this range so that queries work across the antimeridian
+#define GRID_LONGITUDE_CELLS 3600
+
+// define number of buckets the grid cells are hashed into, must be a power of two
+#define GRID_BUCKETS 4096
+
+// define number of rings around the center cell after which a nearest query gives up
+#define MAX_QUERY_RINGS 64
+
+// define number of planes a scan can look at in the time a nearest query searches one cell, the query falls back to a scan once its rings have cost more
+#define NEAREST_CELL_COST 2
+
+// define ratio of the planes to the requested nearest planes below which a nearest query scans all planes right away, sparse traffic needs more cells than planes
+#define NEAREST_SCAN_RATIO 16
+
+// define value of an empty link
+#define LINK_NONE -1
+
+// define nearest candidate struct used for the nearest query, ordered so that the heap keeps the farthest candidate on top
+struct NearestCandidate
+{
+    double distance;
+    int index;
+
+    bool operator<(const NearestCandidate &other) const
+    {
+        return distance < other.distance;
+    }
+};
+
+// global variables
+static int bucketHeads[GRID_BUCKETS]; // first slot in each bucket, LINK_NONE if the bucket is empty
+static int next[MAX_TRACKED_PLANES], previous[MAX_TRACKED_PLANES]; // links of the slots within their bucket
+static int cellLatitudes[MAX_TRACKED_PLANES], cellLongitudes[MAX_TRACKED_PLANES]; // grid cell of each slot
+static unsigned char indexed[MAX_TRACKED_PLANES]; // 1 if the slot is linked into a bucket
+static NearestCandidate nearest[MAX_TRACKED_PLANES];
+static bool initialized = false;
+
+// returns the grid cell coordinate of the given angle in degrees
+inline static int GetCell(double degrees)
+{
+    return (int) floor(degrees / GRID_CELL_SIZE);
+}
+
+// returns the grid cell coordinate of the given longitude or of a neighboring cell in the range from -GRID_LONGITUDE_CELLS / 2 to GRID_LONGITUDE_CELLS / 2 exclusive
+inline static int WrapLongitudeCell(int cellLongitude)
+{
+    int wrapped = (cellLongitude + GRID_LONGITUDE_CELLS / 2) % GRID_LONGITUDE_CELLS;
+    return (wrapped < 0 ? wrapped + GRID_LONGITUDE_CELLS : wrapped) - GRID_LONGITUDE_CELLS / 2;
+}
+
+// returns the bucket of the given grid cell
+inline static int GetBucket(int cellLatitude, int cellLongitude)
+{
+    unsigned int hash = (unsigned int) cellLatitude * 73856093u ^ (unsigned int) cellLongitude * 19349663u;
+    return (int) (hash & (GRID_BUCKETS - 1));
+}
+
+// empties all buckets the first time the grid is used
+static void InitSpatialIndex(void)
+{
+    if (initialized)
+        return;
+
+    ClearSpatialIndex();
+}
+
+// unlinks the slot from its bucket
+static void Unlink(int slot)
+{
+    if (previous[slot] != LINK_NONE)
+        next[previous[slot]] = next[slot];
+    else
+        bucketHeads[GetBucket(cellLatitudes[slot], cellLongitudes[slot])] = next[slot];
+
+    if (next[slot] != LINK_NONE)
+        previous[next[slot]] = previous[slot];
+
+    indexed[slot] = 0;
+}
+
+// inserts the plane in the given slot into the grid cell of the given position or moves it there, only relinks the plane if its cell has changed
+void IndexPlane(unsigned short slot, double latitude, double longitude)
+{
+    InitSpatialIndex();
+
+    int cellLatitude = GetCell(latitude), cellLongitude = WrapLongitudeCell(GetCell(longitude));
+    if (indexed[slot])
+    {
+        if (cellLatitudes[slot] == cellLatitude && cellLongitudes[slot] == cellLongitude)
+            return;
+
+        Unlink(slot);
+    }
+
+    int bucket = GetBucket(cellLatitude, cellLongitude);
+    cellLatitudes[slot] = cellLatitude;
+    cellLongitudes[slot] = cellLongitude;
+    previous[slot] = LINK_NONE;
+    next[slot] = bucketHeads[bucket];
+    if (next[slot] != LINK_NONE)
+        previous[next[slot]] = slot;
+    bucketHeads[bucket] = slot;
+    indexed[slot] = 1;
+}
+
+// removes the plane in the given slot from the grid
+void UnindexPlane(unsigned short slot)
+{
+    if (initialized && indexed[slot])
+        Unlink(slot);
+}
+
+// writes the indices of up to maxResults planes whose last reported position lies inside the given box into results and returns their number, the box must not cross the antimeridian
+int QueryBox(double minLatitude, double minLongitude, double maxLatitude, double maxLongitude, int *results, int maxResults)
+{
+    InitSpatialIndex();
+
+    int count = 0;
+    int minCellLatitude = GetCell(minLatitude), maxCellLatitude = GetCell(maxLatitude);
+    int minCellLongitude = GetCell(minLongitude), maxCellLongitude = GetCell(maxLongitude);
+
+    // a box that covers more cells than there are buckets visits every bucket at most once
+    if ((long long) (maxCellLatitude - minCellLatitude + 1) * (maxCellLongitude - minCellLongitude + 1) > GRID_BUCKETS)
+    {
+        for (int i = 0; i < traffic.count && count < maxResults; i++)
+        {
+            if (traffic.latitude[i] >= minLatitude && traffic.latitude[i] <= maxLatitude && traffic.longitude[i] >= minLongitude && traffic.longitude[i] <= maxLongitude)
+                results[count++] = i;
+        }
+
+        return count;
+    }
+
+    for (int cellLatitude = minCellLatitude; cellLatitude <= maxCellLatitude; cellLatitude++)
+    {
+        for (int c = minCellLongitude; c <= maxCellLongitude; c++)
+        {
+            int cellLongitude = WrapLongitudeCell(c);
+
+            // other cells share the bucket, so every plane is checked against the cell and the box
+            for (int slot = bucketHeads[GetBucket(cellLatitude, cellLongitude)]; slot != LINK_NONE; slot = next[slot])
+            {
+                if (cellLatitudes[slot] != cellLatitude || cellLongitudes[slot] != cellLongitude)
+                    continue;
+
+                int i = FindPlane((unsigned short) slot);
+                if (i == -1 || traffic.latitude[i] < minLatitude || traffic.latitude[i] > maxLatitude || traffic.longitude[i] < minLongitude || traffic.longitude[i] > maxLongitude)
+                    continue;
+
+                if (count == maxResults)
+                    return count;
+
+                results[count++] = i;
+            }
+        }
+    }
+
+    return count;
+}
+
+// writes the indices of up to maxResults planes whose last reported position lies within the given radius in nautical miles into results and returns their number
+int QueryRadius(double latitude, double longitude, double radius, int *results, int maxResults)
+{
+    double cosLatitude = cos(DegreesToRadians(latitude));
+    double latitudeSpan = radius / 60.0;
+    double longitudeSpan = std::min(radius / (60.0 * std::max(cosLatitude, 0.01)), 180.0);
+
+    // a circle that crosses the antimeridian is covered by a box on either side of it
+    double minLongitude = longitude - longitudeSpan, maxLongitude = longitude + longitudeSpan;
+    int count = QueryBox(latitude - latitudeSpan, std::max(minLongitude, -180.0), latitude + latitudeSpan, std::min(maxLongitude, 180.0), results, maxResults);
+    if (minLongitude < -180.0)
+        count += QueryBox(latitude - latitudeSpan, minLongitude + 360.0, latitude + latitudeSpan, 180.0, results + count, maxResults - count);
+    else if (maxLongitude > 180.0)
+        count += QueryBox(latitude - latitudeSpan, -180.0, latitude + latitudeSpan, maxLongitude - 360.0, results + count, maxResults - count);
+
+    // keep the planes inside the circle inscribed into the box
+    int kept = 0;
+    for (int r = 0; r < count; r++)
+    {
+        int i = results[r];
+        if (GetApproximateSquaredDistance(latitude, longitude, traffic.latitude[i], traffic.longitude[i], cosLatitude) <= radius * radius)
+            results[kept++] = i;
+    }
+
+    return kept;
+}
+
+// keeps the plane at the given index among the count nearest candidates found so far if it is nearer than the farthest of them or if fewer than k have been found
+inline static void AddNearest(int i, double distance, int k, int *count)
+{
+    if (*count < k)
+    {
+        nearest[*count].distance = distance;
+        nearest[*count].index = i;
+        std::push_heap(nearest, nearest + ++*count);
+    }
+    else if (distance < nearest[0].distance)
+    {
+        std::pop_heap(nearest, nearest + *count);
+        nearest[*count - 1].distance = distance;
+        nearest[*count - 1].index = i;
+        std::push_heap(nearest, nearest + *count);
+    }
+}
+
+// writes the indices of the k planes whose last reported positions are nearest to the given position into results ordered by their distance and returns their number
+int QueryNearest(double latitude, double longitude, int k, int *results)
+{
+    InitSpatialIndex();
+
+    k = std::min(k, traffic.count);
+    if (k <= 0)
+        return 0;
+
+    double cosLatitude = cos(DegreesToRadians(latitude));
+    double cellDistance = GRID_CELL_SIZE * 60.0 * std::max(cosLatitude, 0.01); // nautical miles, the narrower side of a cell
+    int centerLatitude = GetCell(latitude), centerLongitude = GetCell(longitude);
+    int count = 0, visited = 0, searchedCells = 0;
+    int maxRings = std::min(MAX_QUERY_RINGS, GRID_LONGITUDE_CELLS / 2); // a ring must not wrap around onto cells that have been searched
+    bool complete = false;
+
+    // search rings of cells around the center cell until no cell of the next ring can hold a nearer plane than the k-th nearest so far, sparse traffic is scanned instead once the rings have cost more than a scan
+    if (traffic.count <= k * NEAREST_SCAN_RATIO)
+        maxRings = 0;
+    for (int ring = 0; ring < maxRings && searchedCells * NEAREST_CELL_COST <= traffic.count; ring++)
+    {
+        for (int cellLatitude = centerLatitude - ring; cellLatitude <= centerLatitude + ring; cellLatitude++)
+        {
+            bool edge = cellLatitude == centerLatitude - ring || cellLatitude == centerLatitude + ring;
+            for (int c = centerLongitude - ring; c <= centerLongitude + ring; c += edge || ring == 0 ? 1 : 2 * ring)
+            {
+                int cellLongitude = WrapLongitudeCell(c);
+                for (int slot = bucketHeads[GetBucket(cellLatitude, cellLongitude)]; slot != LINK_NONE; slot = next[slot])
+                {
+                    if (cellLatitudes[slot] != cellLatitude || cellLongitudes[slot] != cellLongitude)
+                        continue;
+
+                    int i = FindPlane((unsigned short) slot);
+                    if (i == -1)
+                        continue;
+
+                    visited++;
+                    AddNearest(i, GetApproximateSquaredDistance(latitude, longitude, traffic.latitude[i], traffic.longitude[i], cosLatitude), k, &count);
+                }
+
+                searchedCells++;
+            }
+        }
+
+        if (visited == traffic.count || (count == k && nearest[0].distance <= (ring * cellDistance) * (ring * cellDistance)))
+        {
+            complete = true;
+            break;
+        }
+    }
+
+    if (complete)
+        std::sort_heap(nearest, nearest + count);
+    else
+    {
+        for (int i = 0; i < traffic.count; i++)
+        {
+            nearest[i].distance = GetApproximateSquaredDistance(latitude, longitude, traffic.latitude[i], traffic.longitude[i], cosLatitude);
+            nearest[i].index = i;
+        }
+
+        count = k;
+        std::nth_element(nearest, nearest + count, nearest + traffic.count);
+        std::sort(nearest, nearest + count);
+    }
+
+    for (int c = 0; c < count; c++)
+        results[c] = nearest[c].index;
+
+    return count;
+}
+
+// removes all planes from the grid
+void ClearSpatialIndex(void)
+{
+    for (int b = 0; b < GRID_BUCKETS; b++)
+        bucketHeads[b] = LINK_NONE;
+
+    for (int s = 0; s < MAX_TRACKED_PLANES; s++)
+        indexed[s] = 0;
+
+    initialized = true;
+}
@@ -0,0 +1,40 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+// inserts the plane in the given slot into the grid cell of the given position or moves it there, only relinks the plane if its cell has changed
+void IndexPlane(unsigned short slot, double latitude, double longitude);
+
+// removes the plane in the given slot from the grid
+void UnindexPlane(unsigned short slot);
+
+// writes the indices of up to maxResults planes whose last reported position lies inside the given box into results and returns their number, the box must not cross the antimeridian
+int QueryBox(double minLatitude, double minLongitude, double maxLatitude, double maxLongitude, int *results, int maxResults);
+
+// writes the indices of up to maxResults planes whose last reported position lies within the given radius in nautical miles into results and returns their number
+int QueryRadius(double latitude, double longitude, double radius, int *results, int maxResults);
+
+// writes the indices of the k planes whose last reported positions are nearest to the given position into results ordered by their distance and returns their number
+int QueryNearest(double latitude, double longitude, int k, int *results);
+
+// removes all planes from the grid
+void ClearSpatialIndex(void);
+
+#endif
@@ -0,0 +1,180 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "tcas.h"
+#include "multiplayer.h"
+#include "spatial.h"
+#include "traffic.h"
+#include "XPLMDataAccess.h"
+
+#include <algorithm>
+#include <string.h>
+
+// define range in nautical miles around the user within which planes are reported to TCAS by their reported horizontal position
+#define TCAS_RANGE 40.0
+
+// define length of a flight ID in the TCAS flight ID array
+#define TCAS_FLIGHT_ID_LENGTH 8
+
+// define TCAS candidate struct used for the ranking
+struct TcasCandidate
+{
+    double distance;
+    int index;
+
+    bool operator<(const TcasCandidate &other) const
+    {
+        return distance < other.distance;
+    }
+};
+
+// global variables
+static XPLMDataRef overrideDataRef = NULL, countDataRef = NULL, modeSDataRef = NULL, flightIdDataRef = NULL, xDataRef = NULL, yDataRef = NULL, zDataRef = NULL, vxDataRef = NULL, vyDataRef = NULL, vzDataRef = NULL, headingDataRef = NULL, pitchDataRef = NULL, rollDataRef = NULL;
+static bool overridden = false;
+static TcasCandidate candidates[MAX_TRACKED_PLANES];
+static int rangePlanes[MAX_TRACKED_PLANES];
+static int targets[MAX_TCAS_TARGETS]; // index of the plane of each target, -1 if the target is unused
+static float xValues[MAX_TCAS_TARGETS], yValues[MAX_TCAS_TARGETS], zValues[MAX_TCAS_TARGETS], vxValues[MAX_TCAS_TARGETS], vyValues[MAX_TCAS_TARGETS], vzValues[MAX_TCAS_TARGETS], headingValues[MAX_TCAS_TARGETS], pitchValues[MAX_TCAS_TARGETS], rollValues[MAX_TCAS_TARGETS];
+static int modeSValues[MAX_TCAS_TARGETS];
+static char flightIds[MAX_TCAS_TARGETS * TCAS_FLIGHT_ID_LENGTH];
+
+// finds the TCAS datarefs, TCAS targets are only written if the sim provides them
+void InitTcas(void)
+{
+    overrideDataRef = XPLMFindDataRef("sim/operation/override/override_TCAS");
+    countDataRef = XPLMFindDataRef("sim/cockpit2/tcas/indicators/tcas_num_acf");
+    modeSDataRef = XPLMFindDataRef("sim/cockpit2/tcas/targets/modeS_id");
+    flightIdDataRef = XPLMFindDataRef("sim/cockpit2/tcas/targets/flight_id");
+    xDataRef = XPLMFindDataRef("sim/cockpit2/tcas/targets/position/x");
+    yDataRef = XPLMFindDataRef("sim/cockpit2/tcas/targets/position/y");
+    zDataRef = XPLMFindDataRef("sim/cockpit2/tcas/targets/position/z");
+    vxDataRef = XPLMFindDataRef("sim/cockpit2/tcas/targets/position/vx");
+    vyDataRef = XPLMFindDataRef("sim/cockpit2/tcas/targets/position/vy");
+    vzDataRef = XPLMFindDataRef("sim/cockpit2/tcas/targets/position/vz");
+    headingDataRef = XPLMFindDataRef("sim/cockpit2/tcas/targets/position/psi");
+    pitchDataRef = XPLMFindDataRef("sim/cockpit2/tcas/targets/position/the");
+    rollDataRef = XPLMFindDataRef("sim/cockpit2/tcas/targets/position/phi");
+}
+
+// writes the multiplayer planes and the nearest further selected planes into the TCAS target arrays with one call per array, the planes in range are found in the spatial index and ranked by their 3D distance, must be called from the sim thread after UpdateMultiplayer
+void UpdateTcas(double userLatitude, double userLongitude, double userX, double userY, double userZ)
+{
+    // X-Plane only lets the owner of the multiplayer planes override TCAS
+    int slotCount = GetMultiplayerSlotCount();
+    if (overrideDataRef == NULL || countDataRef == NULL || xDataRef == NULL || slotCount == 0)
+    {
+        ReleaseTcas();
+        return;
+    }
+
+    if (!overridden)
+    {
+        XPLMSetDatai(overrideDataRef, 1);
+        overridden = true;
+    }
+
+    // the multiplayer planes keep the targets of their slots so that X-Plane renders them where TCAS shows them
+    for (int t = 1; t <= slotCount; t++)
+        targets[t] = GetMultiplayerPlane(t);
+
+    // the remaining targets are filled with the nearest selected planes in range that are not multiplayer planes
+    int candidateCount = 0;
+    int rangeCount = QueryRadius(userLatitude, userLongitude, TCAS_RANGE, rangePlanes, MAX_TRACKED_PLANES);
+    for (int r = 0; r < rangeCount; r++)
+    {
+        int i = rangePlanes[r];
+        if (!traffic.selected[i] || traffic.multiplayer[i])
+            continue;
+
+        double dX = traffic.x[i] - userX, dY = traffic.y[i] - userY, dZ = traffic.z[i] - userZ;
+        candidates[candidateCount].distance = dX * dX + dY * dY + dZ * dZ;
+        candidates[candidateCount].index = i;
+        candidateCount++;
+    }
+
+    int count = std::min(MAX_TCAS_TARGETS - 1 - slotCount, candidateCount);
+    if (count < candidateCount)
+        std::nth_element(candidates, candidates + count, candidates + candidateCount);
+
+    for (int c = 0; c < count; c++)
+        targets[slotCount + 1 + c] = candidates[c].index;
+
+    int targetCount = slotCount + count;
+
+    // gather the targets into the arrays, unused slots are reported with an ID of zero and parked below the user like the multiplayer plane they alias
+    memset(flightIds, 0, sizeof(flightIds));
+    for (int t = 1; t <= targetCount; t++)
+    {
+        int i = targets[t];
+        if (i == -1)
+        {
+            xValues[t] = (float) userX;
+            yValues[t] = (float) PARKING_Y;
+            zValues[t] = (float) userZ;
+            vxValues[t] = vyValues[t] = vzValues[t] = 0.0f;
+            headingValues[t] = pitchValues[t] = rollValues[t] = 0.0f;
+            modeSValues[t] = 0;
+            continue;
+        }
+
+        xValues[t] = (float) traffic.x[i];
+        yValues[t] = (float) traffic.y[i];
+        zValues[t] = (float) traffic.z[i];
+        vxValues[t] = traffic.velocityX[i];
+        vyValues[t] = traffic.velocityY[i];
+        vzValues[t] = traffic.velocityZ[i];
+        headingValues[t] = traffic.interpolatedHeading[i];
+        pitchValues[t] = traffic.pitch[i];
+        rollValues[t] = traffic.roll[i];
+
+        // slots are reused by other planes, the address stays with the aircraft
+        modeSValues[t] = (int) traffic.identity[i].modeSAddress;
+        strncpy(&flightIds[t * TCAS_FLIGHT_ID_LENGTH], traffic.identity[i].icaoId, TCAS_FLIGHT_ID_LENGTH - 1);
+    }
+
+    XPLMSetDatai(countDataRef, targetCount + 1);
+    XPLMSetDatavf(xDataRef, &xValues[1], 1, targetCount);
+    XPLMSetDatavf(yDataRef, &yValues[1], 1, targetCount);
+    XPLMSetDatavf(zDataRef, &zValues[1], 1, targetCount);
+    if (vxDataRef != NULL && vyDataRef != NULL && vzDataRef != NULL)
+    {
+        XPLMSetDatavf(vxDataRef, &vxValues[1], 1, targetCount);
+        XPLMSetDatavf(vyDataRef, &vyValues[1], 1, targetCount);
+        XPLMSetDatavf(vzDataRef, &vzValues[1], 1, targetCount);
+    }
+    if (headingDataRef != NULL && pitchDataRef != NULL && rollDataRef != NULL)
+    {
+        XPLMSetDatavf(headingDataRef, &headingValues[1], 1, targetCount);
+        XPLMSetDatavf(pitchDataRef, &pitchValues[1], 1, targetCount);
+        XPLMSetDatavf(rollDataRef, &rollValues[1], 1, targetCount);
+    }
+    if (modeSDataRef != NULL)
+        XPLMSetDatavi(modeSDataRef, &modeSValues[1], 1, targetCount);
+    if (flightIdDataRef != NULL)
+        XPLMSetDatab(flightIdDataRef, &flightIds[TCAS_FLIGHT_ID_LENGTH], TCAS_FLIGHT_ID_LENGTH, targetCount * TCAS_FLIGHT_ID_LENGTH);
+}
+
+// hands the TCAS targets back to X-Plane, must be called before the multiplayer planes are released
+void ReleaseTcas(void)
+{
+    if (!overridden)
+        return;
+
+    XPLMSetDatai(overrideDataRef, 0);
+    overridden = false;
+}
@@ -0,0 +1,34 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef TCAS_H
+#define TCAS_H
+
+// define number of entries of X-Plane's TCAS target arrays, index 0 is the user's plane
+#define MAX_TCAS_TARGETS 64
+
+// finds the TCAS datarefs, TCAS targets are only written if the sim provides them
+void InitTcas(void);
+
+// writes the multiplayer planes and the nearest further selected planes into the TCAS target arrays with one call per array, the planes in range are found in the spatial index and ranked by their 3D distance, must be called from the sim thread after UpdateMultiplayer
+void UpdateTcas(double userLatitude, double userLongitude, double userX, double userY, double userZ);
+
+// hands the TCAS targets back to X-Plane, must be called before the multiplayer planes are released
+void ReleaseTcas(void);
+
+#endif
@@ -0,0 +1,134 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "terrain.h"
+#include "XPLMGraphics.h"
+#include "XPLMScenery.h"
+
+#include <math.h>
+
+// define size of a cache cell in degrees
+#define TERRAIN_CELL_SIZE (1.0 / 1200.0)
+
+// define number of cells the cache can hold, must be a power of two
+#define TERRAIN_CACHE_SIZE 8192
+
+// define maximum number of cells that can wait for a probe
+#define TERRAIN_MAX_PENDING 256
+
+// define terrain cell states
+#define TERRAIN_CELL_EMPTY 0
+#define TERRAIN_CELL_PENDING 1
+#define TERRAIN_CELL_VALID 2
+
+// define terrain cell struct, a direct-mapped cache entry, a cell that hashes to an occupied entry replaces it
+struct TerrainCell
+{
+    int latitudeIndex;
+    int longitudeIndex;
+    int state; // one of the TERRAIN_CELL_* states
+    double elevation; // meters MSL
+};
+
+// global variables
+static TerrainCell cells[TERRAIN_CACHE_SIZE];
+static int pendingEntries[TERRAIN_MAX_PENDING]; // cache entries waiting for a probe, processed oldest first
+static int pendingStart = 0, pendingCount = 0;
+static XPLMProbeRef probe = NULL;
+
+// returns the cache entry a cell maps to
+inline static int GetEntry(int latitudeIndex, int longitudeIndex)
+{
+    return (int) (((unsigned int) latitudeIndex * 73856093u ^ (unsigned int) longitudeIndex * 19349663u) & (TERRAIN_CACHE_SIZE - 1));
+}
+
+// looks up the cached terrain elevation in meters MSL at the given coordinates, returns false and queues a probe if the elevation is not cached yet
+bool GetTerrainElevation(double latitude, double longitude, double *elevation)
+{
+    int latitudeIndex = (int) floor(latitude / TERRAIN_CELL_SIZE);
+    int longitudeIndex = (int) floor(longitude / TERRAIN_CELL_SIZE);
+    int entry = GetEntry(latitudeIndex, longitudeIndex);
+    TerrainCell *cell = &cells[entry];
+
+    if (cell->state != TERRAIN_CELL_EMPTY && cell->latitudeIndex == latitudeIndex && cell->longitudeIndex == longitudeIndex)
+    {
+        if (cell->state == TERRAIN_CELL_PENDING)
+            return false;
+
+        *elevation = cell->elevation;
+        return true;
+    }
+
+    if (cell->state == TERRAIN_CELL_PENDING || pendingCount == TERRAIN_MAX_PENDING)
+        return false;
+
+    cell->latitudeIndex = latitudeIndex;
+    cell->longitudeIndex = longitudeIndex;
+    cell->state = TERRAIN_CELL_PENDING;
+    pendingEntries[(pendingStart + pendingCount++) % TERRAIN_MAX_PENDING] = entry;
+
+    return false;
+}
+
+// probes the terrain for at most maxProbes queued cells, returns the number of probes that are still queued, must be called from the sim thread
+int ProcessTerrainProbes(int maxProbes)
+{
+    if (probe == NULL)
+        probe = XPLMCreateProbe(xplm_ProbeY);
+
+    for (int i = 0; i < maxProbes && pendingCount > 0; i++)
+    {
+        TerrainCell *cell = &cells[pendingEntries[pendingStart]];
+        pendingStart = (pendingStart + 1) % TERRAIN_MAX_PENDING;
+        pendingCount--;
+
+        double latitude = (cell->latitudeIndex + 0.5) * TERRAIN_CELL_SIZE;
+        double longitude = (cell->longitudeIndex + 0.5) * TERRAIN_CELL_SIZE;
+
+        XPLMProbeInfo_t info;
+        info.structSize = sizeof(info);
+        double x = 0.0, y = 0.0, z = 0.0;
+        XPLMWorldToLocal(latitude, longitude, 0.0, &x, &y, &z);
+
+        if (XPLMProbeTerrainXYZ(probe, x, y, z, &info) == xplm_ProbeHitTerrain)
+        {
+            double unusedLatitude = 0.0, unusedLongitude = 0.0;
+            XPLMLocalToWorld(info.locationX, info.locationY, info.locationZ, &unusedLatitude, &unusedLongitude, &cell->elevation);
+            cell->state = TERRAIN_CELL_VALID;
+        }
+        else
+            cell->state = TERRAIN_CELL_EMPTY;
+    }
+
+    return pendingCount;
+}
+
+// discards all cached elevations and queued probes and destroys the probe
+void ClearTerrainCache(void)
+{
+    for (int i = 0; i < TERRAIN_CACHE_SIZE; i++)
+        cells[i].state = TERRAIN_CELL_EMPTY;
+    pendingStart = 0;
+    pendingCount = 0;
+
+    if (probe != NULL)
+    {
+        XPLMDestroyProbe(probe);
+        probe = NULL;
+    }
+}
@@ -0,0 +1,31 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+// looks up the cached terrain elevation in meters MSL at the given coordinates, returns false and queues a probe if the elevation is not cached yet
+bool GetTerrainElevation(double latitude, double longitude, double *elevation);
+
+// probes the terrain for at most maxProbes queued cells, returns the number of probes that are still queued, must be called from the sim thread
+int ProcessTerrainProbes(int maxProbes);
+
+// discards all cached elevations and queued probes and destroys the probe
+void ClearTerrainCache(void);
+
+#endif
@@ -0,0 +1,546 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "traffic.h"
+#include "geodesy.h"
+#include "spatial.h"
+#include "workers.h"
+#include "XPLMGraphics.h"
+
+#include <math.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// define factors
+#define FACTOR_FEET_TO_METERS 0.3048
+#define FACTOR_KNOTS_TO_METERS_PER_SECOND 0.514444
+
+// define time in seconds over which the local velocity of a plane is sampled
+#define VELOCITY_SAMPLE_TIME 10.0
+
+// define maximum age in seconds of a report that is compensated, older reports are treated as if they were this old
+#define MAX_REPORT_AGE 30.0
+
+// define time in seconds over which the offset between the displayed and a newly reported track is faded out
+#define CORRECTION_TIME 3.0
+
+// define gains of the alpha-beta trackers for heading and speed
+#define TRACKER_ALPHA 0.7
+#define TRACKER_BETA 0.3
+
+// define maximum time in seconds between two reports that are used to estimate rates, after longer gaps the tracker is reset
+#define MAX_TRACK_GAP 15.0
+
+// define limits of the estimated rates
+#define MAX_TURN_RATE 6.0 // degrees per second
+#define MAX_ACCELERATION 5.0 // knots per second
+#define MAX_BANK_ANGLE 45.0 // degrees
+
+// define time in seconds after a report for which the estimated turn and acceleration are extrapolated, afterwards planes continue straight, keeps the turn angle below 1.1 radians for the series expansions
+#define MAX_TURN_TIME 10.0
+
+// define standard gravity in meters per second squared
+#define GRAVITY 9.80665
+
+// define number of planes that are extrapolated per worker chunk, must be a multiple of four
+#define EXTRAPOLATION_CHUNK_SIZE 256
+
+// define coefficients of the arcsine approximation from Abramowitz and Stegun 4.4.45, the absolute error is below 7e-5 radians
+#define ASIN_A0 1.5707288f
+#define ASIN_A1 -0.2121144f
+#define ASIN_A2 0.0742610f
+#define ASIN_A3 -0.0187293f
+
+// external variables
+Traffic traffic;
+
+// global variables
+static int indices[MAX_TRACKED_PLANES]; // index of the plane in each slot
+
+// wraps an angle in degrees to the range -180 to 180
+inline static double WrapAngle(double angle)
+{
+    angle = fmod(angle, 360.0);
+
+    if (angle > 180.0)
+        return angle - 360.0;
+    if (angle < -180.0)
+        return angle + 360.0;
+
+    return angle;
+}
+
+// clamps a value to the range -limit to limit
+inline static double Clamp(double value, double limit)
+{
+    return value < -limit ? -limit : (value > limit ? limit : value);
+}
+
+// returns the fraction of the correction of a plane that is still applied at the given elapsed sim time
+inline static double GetCorrectionWeight(int i, double time)
+{
+    double weight = 1.0 - (time - traffic.correctionTime[i]) / CORRECTION_TIME;
+
+    return weight < 0.0 ? 0.0 : (weight > 1.0 ? 1.0 : weight);
+}
+
+// predicts the local position, altitude, heading and roll of a plane at the given elapsed sim time from its anchor, estimated turn rate and acceleration and fading correction
+static void PredictPlane(int i, double time, double *x, double *y, double *z, double *altitude, float *heading, float *roll)
+{
+    double t = time - traffic.anchorTime[i];
+    double turnTime = t < 0.0 ? 0.0 : (t > MAX_TURN_TIME ? MAX_TURN_TIME : t);
+    double straightTime = t - turnTime;
+
+    // integrals of cos and sin of the turn angle over the turn time as series expansions, exact enough for turn angles up to 1.1 radians
+    double angle = traffic.turnRate[i] * turnTime;
+    double angle2 = angle * angle;
+    double cosIntegral = turnTime * (1.0 - angle2 / 6.0 * (1.0 - angle2 / 20.0 * (1.0 - angle2 / 42.0)));
+    double sinIntegral = turnTime * angle * (0.5 - angle2 / 24.0 * (1.0 - angle2 / 30.0 * (1.0 - angle2 / 56.0)));
+    double cosAngle = 1.0 - traffic.turnRate[i] * sinIntegral;
+    double sinAngle = traffic.turnRate[i] * cosIntegral;
+
+    double turnFactor = 1.0 + traffic.speedRate[i] * turnTime * 0.5;
+    double straightFactor = (1.0 + traffic.speedRate[i] * turnTime) * straightTime;
+    double weight = GetCorrectionWeight(i, time);
+
+    *x = traffic.anchorX[i] + turnFactor * (traffic.velocityX[i] * cosIntegral - traffic.velocityZ[i] * sinIntegral) + straightFactor * (traffic.velocityX[i] * cosAngle - traffic.velocityZ[i] * sinAngle) + traffic.correctionX[i] * weight;
+    *y = traffic.anchorY[i] + traffic.velocityY[i] * t + traffic.correctionY[i] * weight;
+    *z = traffic.anchorZ[i] + turnFactor * (traffic.velocityX[i] * sinIntegral + traffic.velocityZ[i] * cosIntegral) + straightFactor * (traffic.velocityX[i] * sinAngle + traffic.velocityZ[i] * cosAngle) + traffic.correctionZ[i] * weight;
+    *altitude = traffic.altitude[i] + traffic.verticalSpeed[i] / 60.0 * t + traffic.correctionAltitude[i] * weight;
+
+    // the heading follows the turn and the wings are leveled once the turn ends
+    double turnedHeading = traffic.trackHeading[i] + RadiansToDegrees(angle);
+    *heading = (float) (turnedHeading < 0.0 ? turnedHeading + 360.0 : (turnedHeading >= 360.0 ? turnedHeading - 360.0 : turnedHeading));
+    *roll = t > MAX_TURN_TIME ? 0.0f : traffic.bankAngle[i];
+}
+
+// copies all state of the plane at one index to another index
+static void MovePlane(int to, int from)
+{
+    traffic.x[to] = traffic.x[from];
+    traffic.y[to] = traffic.y[from];
+    traffic.z[to] = traffic.z[from];
+    traffic.interpolatedAltitude[to] = traffic.interpolatedAltitude[from];
+    traffic.anchorX[to] = traffic.anchorX[from];
+    traffic.anchorY[to] = traffic.anchorY[from];
+    traffic.anchorZ[to] = traffic.anchorZ[from];
+    traffic.anchorTime[to] = traffic.anchorTime[from];
+    traffic.correctionX[to] = traffic.correctionX[from];
+    traffic.correctionY[to] = traffic.correctionY[from];
+    traffic.correctionZ[to] = traffic.correctionZ[from];
+    traffic.correctionAltitude[to] = traffic.correctionAltitude[from];
+    traffic.correctionTime[to] = traffic.correctionTime[from];
+    traffic.velocityX[to] = traffic.velocityX[from];
+    traffic.velocityY[to] = traffic.velocityY[from];
+    traffic.velocityZ[to] = traffic.velocityZ[from];
+    traffic.turnRate[to] = traffic.turnRate[from];
+    traffic.speedRate[to] = traffic.speedRate[from];
+    traffic.pitch[to] = traffic.pitch[from];
+    traffic.roll[to] = traffic.roll[from];
+    traffic.interpolatedHeading[to] = traffic.interpolatedHeading[from];
+    traffic.bankAngle[to] = traffic.bankAngle[from];
+    traffic.selected[to] = traffic.selected[from];
+    traffic.terrainElevation[to] = traffic.terrainElevation[from];
+    traffic.latitude[to] = traffic.latitude[from];
+    traffic.longitude[to] = traffic.longitude[from];
+    traffic.altitude[to] = traffic.altitude[from];
+    traffic.heading[to] = traffic.heading[from];
+    traffic.speed[to] = traffic.speed[from];
+    traffic.verticalSpeed[to] = traffic.verticalSpeed[from];
+    traffic.anchorState[to] = traffic.anchorState[from];
+    traffic.trackHeading[to] = traffic.trackHeading[from];
+    traffic.trackSpeed[to] = traffic.trackSpeed[from];
+    traffic.trackTurnRate[to] = traffic.trackTurnRate[from];
+    traffic.trackAcceleration[to] = traffic.trackAcceleration[from];
+    traffic.trackTime[to] = traffic.trackTime[from];
+    traffic.slot[to] = traffic.slot[from];
+    traffic.identity[to] = traffic.identity[from];
+    traffic.model[to] = traffic.model[from];
+    traffic.detailTier[to] = traffic.detailTier[from];
+    traffic.multiplayer[to] = traffic.multiplayer[from];
+
+    indices[traffic.slot[to]] = to;
+}
+
+// applies a single delta sent by the update thread to the traffic at the given elapsed sim time and UNIX time, the age of the report is subtracted from its anchor time, never allocates
+void ApplyDelta(const Delta *delta, double time, double wallTime)
+{
+    int i = 0;
+
+    switch (delta->type)
+    {
+    case DELTA_ADD:
+        i = traffic.count++;
+        indices[delta->slot] = i;
+        traffic.slot[i] = delta->slot;
+        traffic.pitch[i] = 0.0f;
+        traffic.roll[i] = 0.0f;
+        traffic.bankAngle[i] = 0.0f;
+        traffic.selected[i] = 0;
+        traffic.terrainElevation[i] = TERRAIN_ELEVATION_UNKNOWN;
+        traffic.anchorState[i] = 0;
+        traffic.correctionX[i] = 0.0;
+        traffic.correctionY[i] = 0.0;
+        traffic.correctionZ[i] = 0.0;
+        traffic.correctionAltitude[i] = 0.0;
+        traffic.correctionTime[i] = time;
+        traffic.turnRate[i] = 0.0f;
+        traffic.speedRate[i] = 0.0f;
+        traffic.trackTime[i] = TRACK_TIME_UNKNOWN;
+        traffic.detailTier[i] = DETAIL_TIER_NONE;
+        traffic.multiplayer[i] = 0;
+        break;
+    case DELTA_UPDATE:
+        i = indices[delta->slot];
+
+        // remember where the plane is displayed before its anchor moves, unless a report in the same frame already did so
+        if ((delta->fields & (DELTA_FIELD_POSITION | DELTA_FIELD_ALTITUDE)) && !(traffic.anchorState[i] & (ANCHOR_POSITION | ANCHOR_BLEND)))
+        {
+            double x = 0.0, y = 0.0, z = 0.0, altitude = 0.0;
+            float heading = 0.0f, roll = 0.0f;
+            PredictPlane(i, time, &x, &y, &z, &altitude, &heading, &roll);
+
+            traffic.correctionX[i] = x;
+            traffic.correctionY[i] = y;
+            traffic.correctionZ[i] = z;
+            traffic.correctionAltitude[i] = altitude;
+            traffic.anchorState[i] |= ANCHOR_BLEND;
+        }
+        break;
+    case DELTA_REMOVE:
+        i = indices[delta->slot];
+        UnindexPlane(delta->slot);
+        if (i != --traffic.count)
+            MovePlane(i, traffic.count);
+        return;
+    }
+
+    if (delta->fields & DELTA_FIELD_POSITION)
+    {
+        traffic.latitude[i] = delta->latitude;
+        traffic.longitude[i] = delta->longitude;
+        IndexPlane(delta->slot, delta->latitude, delta->longitude);
+    }
+    if (delta->fields & DELTA_FIELD_ALTITUDE)
+        traffic.altitude[i] = delta->altitude;
+    if (delta->fields & DELTA_FIELD_HEADING)
+        traffic.heading[i] = delta->heading;
+    if (delta->fields & DELTA_FIELD_SPEED)
+        traffic.speed[i] = (float) delta->speed;
+    if (delta->fields & DELTA_FIELD_VERTICAL_SPEED)
+        traffic.verticalSpeed[i] = (float) delta->verticalSpeed;
+    if (delta->fields & DELTA_FIELD_IDENTITY)
+    {
+        PlaneIdentity *identity = &traffic.identity[i];
+        memcpy(identity->registration, delta->registration, sizeof(identity->registration));
+        memcpy(identity->icaoId, delta->icaoId, sizeof(identity->icaoId));
+        memcpy(identity->icaoType, delta->icaoType, sizeof(identity->icaoType));
+        memcpy(identity->squawk, delta->squawk, sizeof(identity->squawk));
+        identity->modeSAddress = delta->modeSAddress;
+        traffic.model[i] = MODEL_UNRESOLVED;
+    }
+
+    if (delta->fields & (DELTA_FIELD_POSITION | DELTA_FIELD_ALTITUDE))
+    {
+        double age = wallTime - delta->timestamp;
+        traffic.anchorTime[i] = time - (age < 0.0 ? 0.0 : (age > MAX_REPORT_AGE ? MAX_REPORT_AGE : age));
+        traffic.anchorState[i] |= ANCHOR_POSITION | ANCHOR_VELOCITY;
+    }
+    if (delta->fields & (DELTA_FIELD_HEADING | DELTA_FIELD_SPEED | DELTA_FIELD_VERTICAL_SPEED))
+        traffic.anchorState[i] |= ANCHOR_VELOCITY;
+    if (delta->fields & (DELTA_FIELD_POSITION | DELTA_FIELD_ALTITUDE | DELTA_FIELD_HEADING | DELTA_FIELD_SPEED))
+        traffic.anchorState[i] |= ANCHOR_TRACK | ANCHOR_VELOCITY;
+}
+
+// feeds the new reports of all planes into their trackers, estimating turn rate, acceleration and bank angle, must be called before UpdateAnchors
+void UpdateTrackers(void)
+{
+    for (int i = 0; i < traffic.count; i++)
+    {
+        if (!(traffic.anchorState[i] & ANCHOR_TRACK))
+            continue;
+
+        double dt = traffic.anchorTime[i] - traffic.trackTime[i];
+
+        if (traffic.trackTime[i] == TRACK_TIME_UNKNOWN || dt > MAX_TRACK_GAP)
+        {
+            traffic.trackHeading[i] = traffic.heading[i];
+            traffic.trackSpeed[i] = traffic.speed[i];
+            traffic.trackTurnRate[i] = 0.0f;
+            traffic.trackAcceleration[i] = 0.0f;
+            traffic.trackTime[i] = traffic.anchorTime[i];
+        }
+        else
+        {
+            // predict the heading and speed at the time of the report and correct the prediction and the rates by the residuals, a report without a newer timestamp only corrects the prediction
+            double interval = dt > 0.0 ? dt : 0.0;
+            double predictedHeading = traffic.trackHeading[i] + traffic.trackTurnRate[i] * interval;
+            double predictedSpeed = traffic.trackSpeed[i] + traffic.trackAcceleration[i] * interval;
+            double headingResidual = WrapAngle(traffic.heading[i] - predictedHeading);
+            double speedResidual = traffic.speed[i] - predictedSpeed;
+
+            traffic.trackHeading[i] = (float) fmod(predictedHeading + TRACKER_ALPHA * headingResidual + 360.0, 360.0);
+            traffic.trackSpeed[i] = (float) (predictedSpeed + TRACKER_ALPHA * speedResidual);
+            if (traffic.trackSpeed[i] < 0.0f)
+                traffic.trackSpeed[i] = 0.0f;
+
+            if (dt > 0.0)
+            {
+                traffic.trackTurnRate[i] = (float) Clamp(traffic.trackTurnRate[i] + TRACKER_BETA * headingResidual / dt, MAX_TURN_RATE);
+                traffic.trackAcceleration[i] = (float) Clamp(traffic.trackAcceleration[i] + TRACKER_BETA * speedResidual / dt, MAX_ACCELERATION);
+                traffic.trackTime[i] = traffic.anchorTime[i];
+            }
+        }
+
+        double speed = (double) traffic.trackSpeed[i] * FACTOR_KNOTS_TO_METERS_PER_SECOND;
+        double turnRate = DegreesToRadians(traffic.trackTurnRate[i]);
+
+        traffic.turnRate[i] = (float) turnRate;
+        traffic.speedRate[i] = traffic.trackSpeed[i] > 1.0f ? traffic.trackAcceleration[i] / traffic.trackSpeed[i] : 0.0f;
+        traffic.bankAngle[i] = (float) Clamp(RadiansToDegrees(atan(speed * turnRate / GRAVITY)), MAX_BANK_ANGLE);
+
+        traffic.anchorState[i] &= ~ANCHOR_TRACK;
+    }
+}
+
+// recalculates the local anchor and velocity of all planes that received a new report, planes that were already displayed are corrected towards the new track gradually, must be called from the sim thread
+void UpdateAnchors(double earthRadius, double time)
+{
+    for (int i = 0; i < traffic.count; i++)
+    {
+        if (traffic.anchorState[i] == 0)
+            continue;
+
+        double x = 0.0, y = 0.0, z = 0.0;
+        XPLMWorldToLocal(traffic.latitude[i], traffic.longitude[i], traffic.altitude[i] * FACTOR_FEET_TO_METERS, &x, &y, &z);
+
+        if (traffic.anchorState[i] & ANCHOR_POSITION)
+        {
+            traffic.anchorX[i] = x;
+            traffic.anchorY[i] = y;
+            traffic.anchorZ[i] = z;
+        }
+
+        if (traffic.anchorState[i] & ANCHOR_VELOCITY)
+        {
+            double latitude = 0.0, longitude = 0.0;
+            GetDestinationPoint(&latitude, &longitude, traffic.latitude[i], traffic.longitude[i], (double) traffic.trackSpeed[i] * FACTOR_KNOTS_TO_METERS_PER_SECOND * VELOCITY_SAMPLE_TIME, traffic.trackHeading[i], earthRadius);
+            double altitude = traffic.altitude[i] + (double) traffic.verticalSpeed[i] / 60.0 * VELOCITY_SAMPLE_TIME;
+
+            double sampleX = 0.0, sampleY = 0.0, sampleZ = 0.0;
+            XPLMWorldToLocal(latitude, longitude, altitude * FACTOR_FEET_TO_METERS, &sampleX, &sampleY, &sampleZ);
+
+            traffic.velocityX[i] = (float) ((sampleX - x) / VELOCITY_SAMPLE_TIME);
+            traffic.velocityY[i] = (float) ((sampleY - y) / VELOCITY_SAMPLE_TIME);
+            traffic.velocityZ[i] = (float) ((sampleZ - z) / VELOCITY_SAMPLE_TIME);
+        }
+
+        if (traffic.anchorState[i] & ANCHOR_BLEND)
+        {
+            // the stored displayed position minus the uncorrected prediction along the new track becomes the new correction
+            double displayedX = traffic.correctionX[i], displayedY = traffic.correctionY[i], displayedZ = traffic.correctionZ[i], displayedAltitude = traffic.correctionAltitude[i];
+            traffic.correctionX[i] = traffic.correctionY[i] = traffic.correctionZ[i] = traffic.correctionAltitude[i] = 0.0;
+
+            double predictedX = 0.0, predictedY = 0.0, predictedZ = 0.0, predictedAltitude = 0.0;
+            float predictedHeading = 0.0f, predictedRoll = 0.0f;
+            PredictPlane(i, time, &predictedX, &predictedY, &predictedZ, &predictedAltitude, &predictedHeading, &predictedRoll);
+
+            traffic.correctionX[i] = displayedX - predictedX;
+            traffic.correctionY[i] = displayedY - predictedY;
+            traffic.correctionZ[i] = displayedZ - predictedZ;
+            traffic.correctionAltitude[i] = displayedAltitude - predictedAltitude;
+            traffic.correctionTime[i] = time;
+        }
+
+        traffic.anchorState[i] = 0;
+    }
+}
+
+// forces the recalculation of all anchors, must be called when the local coordinate system has moved
+void InvalidateAnchors(void)
+{
+    for (int i = 0; i < traffic.count; i++)
+    {
+        if (traffic.anchorState[i] & ANCHOR_BLEND)
+        {
+            traffic.correctionX[i] = 0.0;
+            traffic.correctionY[i] = 0.0;
+            traffic.correctionZ[i] = 0.0;
+            traffic.correctionAltitude[i] = 0.0;
+        }
+
+        traffic.anchorState[i] = (traffic.anchorState[i] & ANCHOR_TRACK) | ANCHOR_POSITION | ANCHOR_VELOCITY;
+    }
+}
+
+// approximates the arcsine of a value between -1 and 1 in radians
+inline static float AsinApproximation(float x)
+{
+    float a = fabsf(x);
+    float r = (float) (M_PI / 2.0) - sqrtf(1.0f - a) * (ASIN_A0 + a * (ASIN_A1 + a * (ASIN_A2 + a * ASIN_A3)));
+
+    return x < 0.0f ? -r : r;
+}
+
+// calculates the pitch in degrees of a plane from its local velocity
+inline static float GetPitch(float velocityX, float velocityY, float velocityZ)
+{
+    float length = sqrtf(velocityX * velocityX + velocityY * velocityY + velocityZ * velocityZ);
+
+    if (length == 0.0f)
+        return 0.0f;
+
+    return AsinApproximation(velocityY / length) * (float) (180.0 / M_PI);
+}
+
+// extrapolates the planes from begin to end exclusive to the elapsed sim time that context points to, two planes per iteration are processed for the doubles and four for the floats if SSE2 is available, runs on the worker threads
+static void ExtrapolateRange(int begin, int end, void *context)
+{
+    double time = *(const double*) context;
+    int i = begin;
+
+#if defined(__SSE2__)
+    __m128d time2 = _mm_set1_pd(time);
+    __m128d minutesPerSecond2 = _mm_set1_pd(1.0 / 60.0);
+    __m128d zero2 = _mm_setzero_pd();
+    __m128d half2 = _mm_set1_pd(0.5);
+    __m128d one2 = _mm_set1_pd(1.0);
+    __m128d maxTurnTime2 = _mm_set1_pd(MAX_TURN_TIME);
+    __m128d correctionRate2 = _mm_set1_pd(1.0 / CORRECTION_TIME);
+    __m128d degreesPerRadian2 = _mm_set1_pd(180.0 / M_PI);
+    __m128d fullCircle2 = _mm_set1_pd(360.0);
+    for (; i + 2 <= end; i += 2)
+    {
+        __m128d t = _mm_sub_pd(time2, _mm_loadu_pd(&traffic.anchorTime[i]));
+        __m128d turnTime = _mm_min_pd(_mm_max_pd(t, zero2), maxTurnTime2);
+        __m128d straightTime = _mm_sub_pd(t, turnTime);
+        __m128d weight = _mm_sub_pd(one2, _mm_mul_pd(_mm_sub_pd(time2, _mm_loadu_pd(&traffic.correctionTime[i])), correctionRate2));
+        weight = _mm_min_pd(_mm_max_pd(weight, zero2), one2);
+        __m128d velocityX = _mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*) &traffic.velocityX[i]));
+        __m128d velocityY = _mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*) &traffic.velocityY[i]));
+        __m128d velocityZ = _mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*) &traffic.velocityZ[i]));
+        __m128d verticalSpeed = _mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*) &traffic.verticalSpeed[i]));
+        __m128d turnRate = _mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*) &traffic.turnRate[i]));
+        __m128d speedRate = _mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*) &traffic.speedRate[i]));
+
+        __m128d angle = _mm_mul_pd(turnRate, turnTime);
+        __m128d angle2 = _mm_mul_pd(angle, angle);
+        __m128d series = _mm_sub_pd(one2, _mm_mul_pd(angle2, _mm_set1_pd(1.0 / 42.0)));
+        series = _mm_sub_pd(one2, _mm_mul_pd(_mm_mul_pd(angle2, _mm_set1_pd(1.0 / 20.0)), series));
+        series = _mm_sub_pd(one2, _mm_mul_pd(_mm_mul_pd(angle2, _mm_set1_pd(1.0 / 6.0)), series));
+        __m128d cosIntegral = _mm_mul_pd(turnTime, series);
+        series = _mm_sub_pd(one2, _mm_mul_pd(angle2, _mm_set1_pd(1.0 / 56.0)));
+        series = _mm_sub_pd(one2, _mm_mul_pd(_mm_mul_pd(angle2, _mm_set1_pd(1.0 / 30.0)), series));
+        series = _mm_sub_pd(half2, _mm_mul_pd(_mm_mul_pd(angle2, _mm_set1_pd(1.0 / 24.0)), series));
+        __m128d sinIntegral = _mm_mul_pd(_mm_mul_pd(turnTime, angle), series);
+        __m128d cosAngle = _mm_sub_pd(one2, _mm_mul_pd(turnRate, sinIntegral));
+        __m128d sinAngle = _mm_mul_pd(turnRate, cosIntegral);
+
+        __m128d turnFactor = _mm_add_pd(one2, _mm_mul_pd(_mm_mul_pd(speedRate, turnTime), half2));
+        __m128d straightFactor = _mm_mul_pd(_mm_add_pd(one2, _mm_mul_pd(speedRate, turnTime)), straightTime);
+
+        __m128d x = _mm_mul_pd(turnFactor, _mm_sub_pd(_mm_mul_pd(velocityX, cosIntegral), _mm_mul_pd(velocityZ, sinIntegral)));
+        x = _mm_add_pd(x, _mm_mul_pd(straightFactor, _mm_sub_pd(_mm_mul_pd(velocityX, cosAngle), _mm_mul_pd(velocityZ, sinAngle))));
+        __m128d z = _mm_mul_pd(turnFactor, _mm_add_pd(_mm_mul_pd(velocityX, sinIntegral), _mm_mul_pd(velocityZ, cosIntegral)));
+        z = _mm_add_pd(z, _mm_mul_pd(straightFactor, _mm_add_pd(_mm_mul_pd(velocityX, sinAngle), _mm_mul_pd(velocityZ, cosAngle))));
+
+        _mm_storeu_pd(&traffic.x[i], _mm_add_pd(_mm_add_pd(_mm_loadu_pd(&traffic.anchorX[i]), x), _mm_mul_pd(_mm_loadu_pd(&traffic.correctionX[i]), weight)));
+        _mm_storeu_pd(&traffic.y[i], _mm_add_pd(_mm_add_pd(_mm_loadu_pd(&traffic.anchorY[i]), _mm_mul_pd(velocityY, t)), _mm_mul_pd(_mm_loadu_pd(&traffic.correctionY[i]), weight)));
+        _mm_storeu_pd(&traffic.z[i], _mm_add_pd(_mm_add_pd(_mm_loadu_pd(&traffic.anchorZ[i]), z), _mm_mul_pd(_mm_loadu_pd(&traffic.correctionZ[i]), weight)));
+        // the turn angle stays below 60 degrees, so a single correction wraps the heading
+        __m128d heading = _mm_add_pd(_mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*) &traffic.trackHeading[i])), _mm_mul_pd(angle, degreesPerRadian2));
+        heading = _mm_add_pd(heading, _mm_and_pd(_mm_cmplt_pd(heading, zero2), fullCircle2));
+        heading = _mm_sub_pd(heading, _mm_and_pd(_mm_cmpge_pd(heading, fullCircle2), fullCircle2));
+        _mm_storel_pi((__m64*) &traffic.interpolatedHeading[i], _mm_cvtpd_ps(heading));
+        __m128d bankAngle = _mm_cvtps_pd(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*) &traffic.bankAngle[i]));
+        _mm_storel_pi((__m64*) &traffic.roll[i], _mm_cvtpd_ps(_mm_and_pd(_mm_cmple_pd(t, maxTurnTime2), bankAngle)));
+
+        _mm_storeu_pd(&traffic.interpolatedAltitude[i], _mm_add_pd(_mm_add_pd(_mm_loadu_pd(&traffic.altitude[i]), _mm_mul_pd(_mm_mul_pd(verticalSpeed, minutesPerSecond2), t)), _mm_mul_pd(_mm_loadu_pd(&traffic.correctionAltitude[i]), weight)));
+    }
+#endif
+    for (; i < end; i++)
+        PredictPlane(i, time, &traffic.x[i], &traffic.y[i], &traffic.z[i], &traffic.interpolatedAltitude[i], &traffic.interpolatedHeading[i], &traffic.roll[i]);
+
+    i = begin;
+#if defined(__SSE2__)
+    __m128 zero4 = _mm_setzero_ps();
+    __m128 one4 = _mm_set1_ps(1.0f);
+    __m128 signMask4 = _mm_set1_ps(-0.0f);
+    __m128 halfPi4 = _mm_set1_ps((float) (M_PI / 2.0));
+    __m128 degreesPerRadian4 = _mm_set1_ps((float) (180.0 / M_PI));
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 velocityX = _mm_loadu_ps(&traffic.velocityX[i]);
+        __m128 velocityY = _mm_loadu_ps(&traffic.velocityY[i]);
+        __m128 velocityZ = _mm_loadu_ps(&traffic.velocityZ[i]);
+
+        __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(velocityX, velocityX), _mm_mul_ps(velocityY, velocityY)), _mm_mul_ps(velocityZ, velocityZ));
+        __m128 moving = _mm_cmpgt_ps(lengthSquared, zero4);
+        __m128 sine = _mm_and_ps(moving, _mm_div_ps(velocityY, _mm_sqrt_ps(_mm_or_ps(lengthSquared, _mm_andnot_ps(moving, one4)))));
+
+        __m128 sign = _mm_and_ps(sine, signMask4);
+        __m128 a = _mm_andnot_ps(signMask4, sine);
+        __m128 polynomial = _mm_add_ps(_mm_set1_ps(ASIN_A2), _mm_mul_ps(a, _mm_set1_ps(ASIN_A3)));
+        polynomial = _mm_add_ps(_mm_set1_ps(ASIN_A1), _mm_mul_ps(a, polynomial));
+        polynomial = _mm_add_ps(_mm_set1_ps(ASIN_A0), _mm_mul_ps(a, polynomial));
+        __m128 arcsine = _mm_sub_ps(halfPi4, _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(one4, a)), polynomial));
+
+        _mm_storeu_ps(&traffic.pitch[i], _mm_mul_ps(_mm_or_ps(arcsine, sign), degreesPerRadian4));
+    }
+#endif
+    for (; i < end; i++)
+        traffic.pitch[i] = GetPitch(traffic.velocityX[i], traffic.velocityY[i], traffic.velocityZ[i]);
+}
+
+// extrapolates the local position, altitude, heading and roll of all planes along their estimated turn to the given elapsed sim time including their fading corrections and calculates their pitch from their climb vector, the planes are split between the worker threads
+void ExtrapolateTraffic(double time)
+{
+    ParallelFor(traffic.count, EXTRAPOLATION_CHUNK_SIZE, ExtrapolateRange, &time);
+}
+
+// calculates the approximate coordinates of the displayed position of a plane from its last reported position and its local offset from its anchor, must be called after UpdateAnchors
+void GetPlaneCoordinates(int i, double earthRadius, double *latitude, double *longitude)
+{
+    // north is along -Z, the offset from the anchor is only a few kilometers so the local axes are treated as aligned with north and east
+    *latitude = traffic.latitude[i] + RadiansToDegrees((traffic.anchorZ[i] - traffic.z[i]) / earthRadius);
+    *longitude = traffic.longitude[i] + RadiansToDegrees((traffic.x[i] - traffic.anchorX[i]) / (earthRadius * fmax(cos(DegreesToRadians(traffic.latitude[i])), 0.01)));
+
+    if (*longitude >= 180.0)
+        *longitude -= 360.0;
+    else if (*longitude < -180.0)
+        *longitude += 360.0;
+}
+
+// returns the index of the plane in the given slot, -1 if the slot is empty
+int FindPlane(unsigned short slot)
+{
+    int i = indices[slot];
+    if (i < traffic.count && traffic.slot[i] == slot)
+        return i;
+
+    return -1;
+}
+
+// removes all planes from the traffic
+void ClearTraffic(void)
+{
+    traffic.count = 0;
+    ClearSpatialIndex();
+}
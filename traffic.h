@@ -0,0 +1,137 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef TRAFFIC_H
+#define TRAFFIC_H
+
+#include "api.h"
+
+// define value of an unknown terrain elevation
+#define TERRAIN_ELEVATION_UNKNOWN -100000.0
+
+// define value of the model of a plane whose aircraft type has not been resolved yet
+#define MODEL_UNRESOLVED -1
+
+// define value of the tracker time of a plane whose tracker has not taken in a report yet
+#define TRACK_TIME_UNKNOWN -1000000000.0
+
+// define anchor flags
+#define ANCHOR_POSITION 1
+#define ANCHOR_VELOCITY 2
+#define ANCHOR_BLEND 4 // the correction values hold the position at which the plane was displayed when the report arrived
+#define ANCHOR_TRACK 8 // the tracker has not taken in the last report yet
+
+// define detail tiers, planes are drawn with their full model, the proxy model or as an impostor depending on their projected size
+#define DETAIL_TIER_FULL 0
+#define DETAIL_TIER_PROXY 1
+#define DETAIL_TIER_IMPOSTOR 2
+#define DETAIL_TIER_NONE 255 // the plane was not drawn in the last frame
+
+// define plane identity struct, cold data that is not needed for the per-frame update
+struct PlaneIdentity
+{
+    char registration[10]; // registration number
+    char icaoId[9]; // ICAO flight ID
+    char icaoType[5]; // ICAO aircraft type designator
+    char squawk[5]; // squawk code
+    unsigned int modeSAddress; // 24 bit ICAO address, stable for as long as the plane is tracked
+};
+
+// define traffic struct, structure-of-arrays storage of all planes known to the sim thread, the arrays are densely packed so that index i of every array refers to the same plane for all i < count
+struct Traffic
+{
+    int count; // number of planes
+
+    // hot kinematic state, read and written every frame
+    double x[MAX_TRACKED_PLANES]; // OpenGL local coordinates in meters
+    double y[MAX_TRACKED_PLANES];
+    double z[MAX_TRACKED_PLANES];
+    double interpolatedAltitude[MAX_TRACKED_PLANES]; // feet MSL
+    double anchorX[MAX_TRACKED_PLANES]; // OpenGL local coordinates of the last reported position in meters
+    double anchorY[MAX_TRACKED_PLANES];
+    double anchorZ[MAX_TRACKED_PLANES];
+    double anchorTime[MAX_TRACKED_PLANES]; // elapsed sim time in seconds at which the last position was reported, lies in the past by the age of the report
+    double correctionX[MAX_TRACKED_PLANES]; // offset in meters between the displayed and the reported track, fades out over the correction time
+    double correctionY[MAX_TRACKED_PLANES];
+    double correctionZ[MAX_TRACKED_PLANES];
+    double correctionAltitude[MAX_TRACKED_PLANES]; // feet
+    double correctionTime[MAX_TRACKED_PLANES]; // elapsed sim time in seconds at which the correction started fading out
+    float velocityX[MAX_TRACKED_PLANES]; // OpenGL local velocity in meters per second
+    float velocityY[MAX_TRACKED_PLANES];
+    float velocityZ[MAX_TRACKED_PLANES];
+    float turnRate[MAX_TRACKED_PLANES]; // estimated rate of change of the heading in radians per second, positive to the right
+    float speedRate[MAX_TRACKED_PLANES]; // estimated acceleration relative to the speed in 1 per second
+    float pitch[MAX_TRACKED_PLANES]; // degrees
+    float roll[MAX_TRACKED_PLANES]; // degrees, level once the estimated turn has ended
+    float interpolatedHeading[MAX_TRACKED_PLANES]; // degrees, the tracked heading advanced along the estimated turn
+    unsigned char selected[MAX_TRACKED_PLANES]; // 1 if the plane was selected for display in the last selection
+    double terrainElevation[MAX_TRACKED_PLANES]; // feet MSL at the interpolated position, TERRAIN_ELEVATION_UNKNOWN if the plane is above the terrain probe band
+
+    // last reported state, only read when a new report arrives or the local origin shifts
+    double latitude[MAX_TRACKED_PLANES]; // degrees
+    double longitude[MAX_TRACKED_PLANES]; // degrees
+    double altitude[MAX_TRACKED_PLANES]; // feet MSL
+    float heading[MAX_TRACKED_PLANES]; // degrees
+    float speed[MAX_TRACKED_PLANES]; // knots
+    float verticalSpeed[MAX_TRACKED_PLANES]; // feet per minute
+    unsigned char anchorState[MAX_TRACKED_PLANES]; // ANCHOR_* flags of the anchor values that must be recalculated
+
+    // alpha-beta tracker state, only read and written when a new report arrives
+    float trackHeading[MAX_TRACKED_PLANES]; // filtered heading in degrees
+    float trackSpeed[MAX_TRACKED_PLANES]; // filtered speed in knots
+    float trackTurnRate[MAX_TRACKED_PLANES]; // degrees per second
+    float trackAcceleration[MAX_TRACKED_PLANES]; // knots per second
+    float bankAngle[MAX_TRACKED_PLANES]; // roll in degrees while the plane follows its estimated turn
+    double trackTime[MAX_TRACKED_PLANES]; // elapsed sim time in seconds of the last report taken in by the tracker, TRACK_TIME_UNKNOWN if there was none
+
+    // cold data
+    unsigned short slot[MAX_TRACKED_PLANES]; // slot of the plane at each index
+    PlaneIdentity identity[MAX_TRACKED_PLANES];
+    short model[MAX_TRACKED_PLANES]; // model the plane is drawn with, MODEL_UNRESOLVED if the aircraft type has changed since it was resolved
+    unsigned char detailTier[MAX_TRACKED_PLANES]; // DETAIL_TIER_* the plane was drawn with in the last frame
+    unsigned char multiplayer[MAX_TRACKED_PLANES]; // 1 if the plane is shown in a multiplayer slot and rendered by X-Plane
+};
+
+// external variables
+extern Traffic traffic; // only accessed by the sim thread
+
+// applies a single delta sent by the update thread to the traffic at the given elapsed sim time and UNIX time, the age of the report is subtracted from its anchor time, never allocates
+void ApplyDelta(const Delta *delta, double time, double wallTime);
+
+// feeds the new reports of all planes into their trackers, estimating turn rate, acceleration and bank angle, must be called before UpdateAnchors
+void UpdateTrackers(void);
+
+// recalculates the local anchor and velocity of all planes that received a new report, planes that were already displayed are corrected towards the new track gradually, must be called from the sim thread
+void UpdateAnchors(double earthRadius, double time);
+
+// forces the recalculation of all anchors, must be called when the local coordinate system has moved
+void InvalidateAnchors(void);
+
+// extrapolates the local position, altitude, heading and roll of all planes along their estimated turn to the given elapsed sim time and calculates their pitch from their climb vector
+void ExtrapolateTraffic(double time);
+
+// calculates the approximate coordinates of the displayed position of a plane from its last reported position and its local offset from its anchor, must be called after UpdateAnchors
+void GetPlaneCoordinates(int i, double earthRadius, double *latitude, double *longitude);
+
+// returns the index of the plane in the given slot, -1 if the slot is empty
+int FindPlane(unsigned short slot);
+
+// removes all planes from the traffic
+void ClearTraffic(void);
+
+#endif
@@ -0,0 +1,199 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "workers.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+// define maximum number of worker threads, the sim thread takes part in every job in addition
+#define MAX_WORKERS 7
+
+// define maximum number of chunks of a job, the chunk index and the end of a queue's range each take 16 bits of its state
+#define MAX_CHUNKS 65535
+
+// define chunk queue struct, the range of chunks a participant processes first, other participants steal from the same range once their own is exhausted
+struct ChunkQueue
+{
+    unsigned long long state; // job generation in the upper 32 bits, next chunk to take and end of the range (exclusive) in 16 bits each, claimed atomically by every participant
+    char padding[56]; // keeps the queues of different participants on separate cache lines
+};
+
+// define job struct, copied by every participant so that the shared job state can be replaced as soon as all chunks are done
+struct Job
+{
+    unsigned int generation;
+    ParallelFunction function;
+    void *context;
+    int count;
+    int chunkSize;
+};
+
+// global variables
+static pthread_t workers[MAX_WORKERS];
+static int workerCount = 0;
+static ChunkQueue queues[MAX_WORKERS + 1]; // the last queue belongs to the sim thread
+static pthread_mutex_t jobMutex;
+static pthread_cond_t jobCondition;
+static Job job; // current job, guarded by jobMutex
+static bool running = false;
+static unsigned int completedChunks = 0; // number of chunks of the current job that have been processed
+
+// claims the next chunk from the given queue if it still belongs to the job of the given generation, returns -1 if there is none
+static int ClaimChunk(ChunkQueue *queue, unsigned int generation)
+{
+    unsigned long long state = __atomic_load_n(&queue->state, __ATOMIC_ACQUIRE);
+    while (true)
+    {
+        unsigned int next = (unsigned int) (state >> 16) & 0xFFFF;
+        unsigned int end = (unsigned int) state & 0xFFFF;
+        if ((unsigned int) (state >> 32) != generation || next >= end)
+            return -1;
+
+        if (__atomic_compare_exchange_n(&queue->state, &state, state + (1ULL << 16), true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+            return (int) next;
+    }
+}
+
+// processes chunks of the given job, first from the queue of the given participant and then from all others until no chunk of the job is left
+static void RunChunks(int participant, const Job *current)
+{
+    for (int i = 0; i <= workerCount; i++)
+    {
+        ChunkQueue *queue = &queues[(participant + i) % (workerCount + 1)];
+
+        int chunk = 0;
+        while ((chunk = ClaimChunk(queue, current->generation)) != -1)
+        {
+            int begin = chunk * current->chunkSize;
+            int end = begin + current->chunkSize < current->count ? begin + current->chunkSize : current->count;
+            current->function(begin, end, current->context);
+            __atomic_add_fetch(&completedChunks, 1, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+// thread function of a worker, waits for jobs and processes their chunks, a worker that wakes up after its job is done finds no chunk of that generation and waits again
+static void *WorkerThreadFunction(void *ptr)
+{
+    int participant = (int) (long) ptr;
+    unsigned int generation = 0;
+
+    pthread_mutex_lock(&jobMutex);
+    while (true)
+    {
+        while (running && job.generation == generation)
+            pthread_cond_wait(&jobCondition, &jobMutex);
+
+        if (!running)
+            break;
+
+        Job current = job;
+        generation = current.generation;
+        pthread_mutex_unlock(&jobMutex);
+
+        RunChunks(participant, &current);
+
+        pthread_mutex_lock(&jobMutex);
+    }
+    pthread_mutex_unlock(&jobMutex);
+
+    return NULL;
+}
+
+// runs function over the indices from 0 to count exclusive in chunks of chunkSize on the worker threads and the calling thread, returns once all chunks are done, small jobs are run on the calling thread only, must only be called from the sim thread
+void ParallelFor(int count, int chunkSize, ParallelFunction function, void *context)
+{
+    if (count <= 0)
+        return;
+
+    if (workerCount == 0 || count <= chunkSize)
+    {
+        function(0, count, context);
+        return;
+    }
+
+    if ((count + chunkSize - 1) / chunkSize > MAX_CHUNKS)
+        chunkSize = (count + MAX_CHUNKS - 1) / MAX_CHUNKS;
+
+    pthread_mutex_lock(&jobMutex);
+    job.generation++;
+    job.function = function;
+    job.context = context;
+    job.count = count;
+    job.chunkSize = chunkSize;
+    Job current = job;
+
+    // split the chunks evenly between the participants, workers still busy with the previous job stop claiming once they see the new generation
+    unsigned int chunkCount = (unsigned int) ((count + chunkSize - 1) / chunkSize);
+    unsigned int participantCount = (unsigned int) workerCount + 1;
+    __atomic_store_n(&completedChunks, 0, __ATOMIC_RELAXED);
+    for (unsigned int p = 0; p < participantCount; p++)
+    {
+        unsigned long long begin = chunkCount * p / participantCount, end = chunkCount * (p + 1) / participantCount;
+        __atomic_store_n(&queues[p].state, ((unsigned long long) current.generation << 32) | (begin << 16) | end, __ATOMIC_RELEASE);
+    }
+
+    pthread_cond_broadcast(&jobCondition);
+    pthread_mutex_unlock(&jobMutex);
+
+    RunChunks(workerCount, &current);
+
+    // only the chunks have to be done, workers that have not woken up yet find nothing left of this job
+    while (__atomic_load_n(&completedChunks, __ATOMIC_ACQUIRE) < chunkCount)
+        sched_yield();
+}
+
+// starts one worker thread per additional processor core
+void WorkersInit(void)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int count = cores > 1 ? (int) cores - 1 : 0;
+    if (count > MAX_WORKERS)
+        count = MAX_WORKERS;
+
+    pthread_mutex_init(&jobMutex, 0);
+    pthread_cond_init(&jobCondition, 0);
+    running = true;
+
+    workerCount = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (pthread_create(&workers[workerCount], NULL, WorkerThreadFunction, (void*) (long) workerCount) != 0)
+            break;
+
+        workerCount++;
+    }
+}
+
+// stops the worker threads
+void WorkersCleanup(void)
+{
+    pthread_mutex_lock(&jobMutex);
+    running = false;
+    pthread_cond_broadcast(&jobCondition);
+    pthread_mutex_unlock(&jobMutex);
+
+    for (int i = 0; i < workerCount; i++)
+        pthread_join(workers[i], NULL);
+    workerCount = 0;
+
+    pthread_cond_destroy(&jobCondition);
+    pthread_mutex_destroy(&jobMutex);
+}
@@ -0,0 +1,34 @@
+/* Copyright (C) 2015  Matteo Hausner
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+// define function type of a parallel job, processes the indices from begin to end exclusive, must not call any XPLM function
+typedef void (*ParallelFunction)(int begin, int end, void *context);
+
+// runs function over the indices from 0 to count exclusive in chunks of chunkSize on the worker threads and the calling thread, returns once all chunks are done, small jobs are run on the calling thread only, must only be called from the sim thread
+void ParallelFor(int count, int chunkSize, ParallelFunction function, void *context);
+
+// starts one worker thread per additional processor core
+void WorkersInit(void);
+
+// stops the worker threads
+void WorkersCleanup(void);
+
+#endif
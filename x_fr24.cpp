@@ -16,17 +16,36 @@
  */
 
 #include "api.h"
+#include "drawlist.h"
+#include "labels.h"
+#include "log.h"
+#include "map.h"
+#include "models.h"
+#include "multiplayer.h"
+#include "scheduler.h"
+#include "selection.h"
+#include "tcas.h"
+#include "terrain.h"
+#include "traffic.h"
+#include "workers.h"
+#include "XPLMCamera.h"
 #include "XPLMDataAccess.h"
 #include "XPLMDisplay.h"
 #include "XPLMGraphics.h"
+#include "XPLMPlugin.h"
 #include "XPLMProcessing.h"
 #include "XPLMScenery.h"
-#include "XPLMUtilities.h" //TODO Remove
+#include "XPLMUtilities.h"
 
+#if APL
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h> //TODO Remove
+#include <sys/time.h>
 
 // define name
 #define NAME "X-fr24"
@@ -35,159 +54,351 @@
 // define version
 #define VERSION "0.1"
 
-// define maximum number of planes
+// define default maximum number of planes that are displayed, can be changed at runtime through the max_planes dataref
 #define MAX_PLANES 64
 
-// define obj path
+// define path of the placeholder model, planes are drawn with it until their own model is loaded
 #define OBJ_PATH "Resources/default scenery/sim objects/apt_aircraft/heavy_metal/MD-80_Scandinavian/MD80_SAS.obj"
 
 // define factor knots to meters per second
 #define FACTOR_FEET_TO_METERS 0.3048
-#define FACTOR_KNOTS_TO_METERS_PER_SECOND 0.514444
 #define MAX_SNAP_TO_GROUND_ALTITUDE 5.0 // feet AGL
 
+// define default altitude band above the terrain in which planes are snapped to the ground, can be changed at runtime through the terrain_probe_band dataref
+#define TERRAIN_PROBE_BAND 2000.0 // feet AGL
+
+// define groundspeed in knots below which a plane is assumed to be on the ground and the terrain below it is probed regardless of its height above the terrain below the user
+#define MAX_GROUND_SPEED 60.0
+
+// define default time in microseconds per frame after which deferrable work is postponed to the next frame, can be changed at runtime through the frame_budget dataref
+#define FRAME_BUDGET 2000
+
+// define size in pixels and color of the point sprites distant planes are drawn as
+#define IMPOSTOR_SIZE 3.0f
+#define IMPOSTOR_COLOR 1.0f, 1.0f, 0.9f, 0.9f
+
+// define name of the log file in the X-Plane folder
+#define LOG_FILE NAME_LOWERCASE "_log.txt"
+
+// define name of the file in the X-Plane folder that maps ICAO aircraft types to models
+#define MODELS_FILE NAME_LOWERCASE "_models.txt"
+
+// define maximum number of deltas applied per flight loop, bounds the worst-case cost of a burst of updates
+#define MAX_DELTAS_PER_FLIGHT_LOOP 4096
+
+// define value of sim/graphics/view/world_render_type while the main view is drawn, other values are drawn for shadows and reflections
+#define WORLD_RENDER_TYPE_NORMAL 0
+
 // global dataref variables
-static XPLMDataRef latitudeDataRef = NULL, longitudeDataRef = NULL, elevationDataRef = NULL, earthRadiusMDataRef = NULL;
+static XPLMDataRef latitudeDataRef = NULL, longitudeDataRef = NULL, elevationDataRef = NULL, earthRadiusMDataRef = NULL, localXDataRef = NULL, localYDataRef = NULL, localZDataRef = NULL, localVxDataRef = NULL, localVzDataRef = NULL, latRefDataRef = NULL, lonRefDataRef = NULL, yAglDataRef = NULL, fieldOfViewDataRef = NULL, windowWidthDataRef = NULL, windowHeightDataRef = NULL, maxPlanesDataRef = NULL, logLevelDataRef = NULL, terrainProbeBandDataRef = NULL, frameBudgetDataRef = NULL, showLabelsDataRef = NULL, showMapDataRef = NULL, modelLoadLatencyDataRef = NULL, modelCacheHitRateDataRef = NULL, culledPlanesDataRef = NULL, worldRenderTypeDataRef = NULL;
 
 // global internal variables
-static XPLMObjectRef object = NULL;
-static XPLMProbeRef probe = NULL;
+static float latRef = 0.0f, lonRef = 0.0f; // origin of the local coordinate system the anchors were calculated in
+static bool originShifted = false; // set when a scenery load has moved the local coordinate system, the anchors are rebuilt in the next flight loop
+static int maxPlanes = MAX_PLANES;
+static float terrainProbeBand = TERRAIN_PROBE_BAND;
+static int frameBudget = FRAME_BUDGET;
+static int showLabels = 0;
+static XPLMObjectRef selectedObjects[MAX_TRACKED_PLANES]; // model of each selected plane
+static XPLMObjectRef proxyObject = NULL; // low detail model for planes of medium projected size
+static int drawListCycle = -1; // cycle number of the frame the draw list was built for
+static int labelCycle = -1; // cycle number of the frame the labels were projected for
+
+// returns the maximum number of planes that are displayed
+static int GetMaxPlanesCallback(void *inRefcon)
+{
+    return maxPlanes;
+}
 
-// converts from degrees to radians
-inline static double DegreesToRadians(double degrees)
+// sets the maximum number of planes that are displayed
+static void SetMaxPlanesCallback(void *inRefcon, int inValue)
 {
-    return degrees * (M_PI / 180.0);
+    maxPlanes = inValue < 0 ? 0 : (inValue > MAX_TRACKED_PLANES ? MAX_TRACKED_PLANES : inValue);
 }
 
-// converts from degrees to radians
-inline static double RadiansToDegrees(double radians)
+// returns the current log level
+static int GetLogLevelCallback(void *inRefcon)
 {
-    return radians * (180.0 / M_PI);
+    return logLevel;
 }
 
-// calculates the destination point given distance and bearing from a starting point
-static void GetDestinationPoint(double *destinationLatitude, double *destinationLongitude, double startLatitude, double startLongitude, double distance, double bearing)
+// sets the current log level
+static void SetLogLevelCallback(void *inRefcon, int inValue)
 {
-    double d = (double) (distance / XPLMGetDataf(earthRadiusMDataRef));
+    logLevel = inValue;
+}
 
-    *destinationLatitude = RadiansToDegrees(asin(sin(DegreesToRadians(startLatitude)) * cos(d) + cos(DegreesToRadians(startLatitude)) * sin(d) * cos(DegreesToRadians(bearing))));
-    *destinationLongitude = RadiansToDegrees(DegreesToRadians(startLongitude) + atan2(sin(DegreesToRadians(bearing)) * sin(d) * cos(DegreesToRadians(startLatitude)), cos(d) - sin(DegreesToRadians(startLatitude)) * sin(DegreesToRadians(*destinationLatitude))));
+// returns the altitude band above the terrain in which planes are snapped to the ground
+static float GetTerrainProbeBandCallback(void *inRefcon)
+{
+    return terrainProbeBand;
 }
 
-// normalizes a given two dimensional vector
-static void NormalizeVector(double *x, double *y)
+// sets the altitude band above the terrain in which planes are snapped to the ground
+static void SetTerrainProbeBandCallback(void *inRefcon, float inValue)
 {
-    double length = sqrt(pow(*x, 2) + pow(*y, 2));
+    terrainProbeBand = inValue;
+}
 
-    if(length != 0)
-    {
-        *x = *x / length;
-        *y = *y / length;
-    }
+// returns the time in microseconds per frame after which deferrable work is postponed
+static int GetFrameBudgetCallback(void *inRefcon)
+{
+    return frameBudget;
+}
+
+// sets the time in microseconds per frame after which deferrable work is postponed
+static void SetFrameBudgetCallback(void *inRefcon, int inValue)
+{
+    frameBudget = inValue < 0 ? 0 : inValue;
+}
+
+// returns 1 if the planes are labelled with their flight ID and aircraft type
+static int GetShowLabelsCallback(void *inRefcon)
+{
+    return showLabels;
+}
+
+// enables or disables the labels
+static void SetShowLabelsCallback(void *inRefcon, int inValue)
+{
+    showLabels = inValue != 0;
+}
+
+// returns 1 if the moving map window is visible
+static int GetShowMapCallback(void *inRefcon)
+{
+    return IsMapVisible();
+}
+
+// shows or hides the moving map window
+static void SetShowMapCallback(void *inRefcon, int inValue)
+{
+    ShowMap(inValue != 0);
+}
+
+// returns the average time in milliseconds from requesting a model until it is loaded
+static float GetModelLoadLatencyCallback(void *inRefcon)
+{
+    return GetModelLoadLatency();
+}
+
+// returns the fraction of model references that were served by a loaded model rather than caused a load
+static float GetModelCacheHitRateCallback(void *inRefcon)
+{
+    return GetModelCacheHitRate();
+}
+
+// returns the number of selected planes that were culled in the last frame
+static int GetCulledPlanesCallback(void *inRefcon)
+{
+    return culledCount;
+}
+
+// deferrable task that probes the terrain below a single plane
+static int TerrainProbeTask(void *context)
+{
+    return ProcessTerrainProbes(1);
+}
+
+// deferrable task that starts loading a single model
+static int ModelLoadTask(void *context)
+{
+    return ProcessModelLoads();
+}
+
+// deferrable task that unloads a single unused model
+static int ModelUnloadTask(void *context)
+{
+    return ProcessModelUnloads();
+}
+
+// deferrable task that loads the aircraft model of a single multiplayer plane
+static int MultiplayerModelTask(void *context)
+{
+    return ProcessMultiplayerModels();
+}
+
+// deferrable task that places the labels of the last projection
+static int LabelLayoutTask(void *context)
+{
+    return LayoutLabels();
 }
 
 // flightloop-callback that interpolates the planes' positions between updates
 static float FlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void *inRefcon)
 {
-    if (probe == NULL)
-        probe = XPLMCreateProbe(xplm_ProbeY);
+    long long frameStart = GetMicroseconds();
 
     SetPosition(XPLMGetDataf(latitudeDataRef), XPLMGetDataf(longitudeDataRef));
 
-    char o[1024];
-    sprintf(o, "Count = %d\n", (int) planes.size());
-    XPLMDebugString(o);
+    double time = XPLMGetElapsedTime();
 
-    pthread_mutex_lock(&planesMutex);
-    for (std::map<std::string, Plane*>::iterator p = planes.begin(); p != planes.end(); ++p)
+    // the reports carry UNIX timestamps, the wall clock is needed to determine their age
+    struct timeval wallClock;
+    gettimeofday(&wallClock, NULL);
+    double wallTime = (double) wallClock.tv_sec + (double) wallClock.tv_usec / 1000000.0;
+
+    Delta delta;
+    int appliedDeltas = 0;
+    for (; appliedDeltas < MAX_DELTAS_PER_FLIGHT_LOOP && PopDelta(&delta); appliedDeltas++)
     {
-        Plane *plane = p->second;
-        double distance = ((double) plane->speed * FACTOR_KNOTS_TO_METERS_PER_SECOND) * (double) inElapsedSinceLastCall; // in meters
-
-        double latitude = 0.0;
-        if (plane->interpolatedLatitude != 0.0)
-            latitude = plane->interpolatedLatitude;
-        else
-            latitude = plane->latitude;
-
-        double longitude = 0.0;
-        if (plane->interpolatedLongitude != 0.0)
-            longitude = plane->interpolatedLongitude;
-        else
-            longitude = plane->longitude;
-
-        double altitude = 0.0;
-        if (plane->interpolatedAltitude != -1000.0)
-            altitude = plane->interpolatedAltitude;
-        else
-            altitude = plane->altitude;
-
-        double newLatitude = 0.0f, newLongitude = 0.0f;
-        GetDestinationPoint(&newLatitude, &newLongitude, latitude, longitude, distance, plane->heading);
-
-        double newAltitude = altitude + ((double) plane->verticalSpeed / 60.0) * (double) inElapsedSinceLastCall;
-
-        XPLMProbeInfo_t info;
-        info.structSize = sizeof(info);
-        double x = 0.0, y = 0.0, z = 0.0;
-        XPLMWorldToLocal(newLatitude, newLongitude, 0.0, &x, &y, &z);
-
-        if (XPLMProbeTerrainXYZ(probe, x, y, z, &info) == xplm_ProbeHitTerrain)
+        // the slot of a removed plane may be reused by a new plane in the same flight loop, it must not inherit any state
+        if (delta.type == DELTA_REMOVE)
         {
+            RemoveMultiplayerPlane(delta.slot);
+            RemoveLabel(delta.slot);
+        }
+
+        ApplyDelta(&delta, time, wallTime);
+    }
+
+    // the map is rebuilt when new reports have arrived, in between it follows the user and the extrapolated planes by itself
+    if (appliedDeltas > 0)
+        InvalidateMap();
+
+    // estimate turn rates and accelerations from the new reports
+    UpdateTrackers();
+
+    if (LogEnabled(LOG_LEVEL_DEBUG))
+    {
+        double values[] = {(double) traffic.count};
+        LogValues(LOG_LEVEL_DEBUG, LOG_CATEGORY_TRAFFIC, "Count = %.0f", NULL, 1, values);
+    }
+
+    // the geodesic calculations are only redone for new reports or if the local coordinate system has moved
+    if (originShifted)
+    {
+        InvalidateAnchors();
+        InvalidateMap();
+        originShifted = false;
+    }
+    double earthRadius = XPLMGetDataf(earthRadiusMDataRef);
+    UpdateAnchors(earthRadius, time);
+
+    // extrapolate the planes' positions in local coordinates and calculate their pitch
+    ExtrapolateTraffic(time);
+
+    // select the planes that are displayed
+    SelectPlanes(maxPlanes, XPLMGetDatad(localXDataRef), XPLMGetDatad(localZDataRef), XPLMGetDatad(elevationDataRef), XPLMGetDataf(localVxDataRef), XPLMGetDataf(localVzDataRef));
 
-            double unusedLatitude = 0.0, unusedLongitude = 0.0, terrainElevation = 0.0; // in meters
-            XPLMLocalToWorld(info.locationX, info.locationY, info.locationZ, &unusedLatitude, &unusedLongitude, &terrainElevation);
-            terrainElevation /= FACTOR_FEET_TO_METERS; // convert to feet
+    // snap the selected planes that are close to the terrain to the ground, the terrain elevation below the user is used as reference until a plane's terrain elevation is cached, slow planes are probed anyway as they may sit on a field far above the user's terrain
+    double userTerrainElevation = (XPLMGetDatad(elevationDataRef) - XPLMGetDataf(yAglDataRef)) / FACTOR_FEET_TO_METERS;
+    for (int s = 0; s < selectedCount; s++)
+    {
+        int i = selectedIndices[s];
+        double altitude = traffic.interpolatedAltitude[i];
 
-            if (newAltitude < terrainElevation || newAltitude - terrainElevation <= MAX_SNAP_TO_GROUND_ALTITUDE)
-                newAltitude = terrainElevation;
+        if (altitude - userTerrainElevation <= terrainProbeBand || traffic.terrainElevation[i] != TERRAIN_ELEVATION_UNKNOWN || traffic.speed[i] < MAX_GROUND_SPEED)
+        {
+            // the coordinates are derived from the anchor rather than converted with XPLMLocalToWorld, a terrain cell is large enough to hide the difference
+            double latitude = 0.0, longitude = 0.0;
+            GetPlaneCoordinates(i, earthRadius, &latitude, &longitude);
+
+            double terrainElevation = 0.0; // in meters
+            if (GetTerrainElevation(latitude, longitude, &terrainElevation))
+                traffic.terrainElevation[i] = terrainElevation / FACTOR_FEET_TO_METERS; // convert to feet
+
+            if (traffic.terrainElevation[i] != TERRAIN_ELEVATION_UNKNOWN && altitude - traffic.terrainElevation[i] > terrainProbeBand)
+                traffic.terrainElevation[i] = TERRAIN_ELEVATION_UNKNOWN;
+            else if (traffic.terrainElevation[i] != TERRAIN_ELEVATION_UNKNOWN && (altitude < traffic.terrainElevation[i] || altitude - traffic.terrainElevation[i] <= MAX_SNAP_TO_GROUND_ALTITUDE))
+            {
+                traffic.interpolatedAltitude[i] = traffic.terrainElevation[i];
+                traffic.y[i] += (traffic.terrainElevation[i] - altitude) * FACTOR_FEET_TO_METERS;
+                traffic.pitch[i] = 0.0f;
+            }
         }
 
-        double vX = distance, vY = newAltitude - altitude;
-        NormalizeVector(&vX, &vY);
-        float newPitch = RadiansToDegrees(asin(vY));
+        if (LogEnabled(LOG_LEVEL_DEBUG))
+        {
+            double values[] = {traffic.x[i], traffic.y[i], traffic.z[i], traffic.pitch[i], altitude, traffic.interpolatedAltitude[i], traffic.verticalSpeed[i]};
+            LogValues(LOG_LEVEL_DEBUG, LOG_CATEGORY_INTERPOLATION, "%s: X = %f, Y = %f, Z = %f, Pitch = %f, Old Alt = %f, New Alt = %f, VS = %.0f", traffic.identity[i].icaoId, 7, values);
+        }
+    }
 
-        char out[1024];
-        sprintf(out, "%s:\n Distance = %f\n Old Lat = %f\n New Lat = %f\n Old Lon = %f\n New Lon = %f\n Old Pitch = %f\n New Pitch = %f\n Old Alt = %f\n New Alt = %f\n VS = % d\n", p->first.c_str(), distance, latitude, longitude, newLatitude, newLongitude, plane->pitch, newPitch, altitude, newAltitude, plane->verticalSpeed);
-        XPLMDebugString(out);
+    // look up the models of the selected planes, models that are not loaded yet are requested and the placeholder is drawn instead
+    BeginModelFrame();
+    for (int s = 0; s < selectedCount; s++)
+    {
+        int i = selectedIndices[s];
+        if (traffic.model[i] == MODEL_UNRESOLVED)
+            traffic.model[i] = (short) FindModel(traffic.identity[i].icaoType);
 
-        plane->interpolatedLatitude = newLatitude;
-        plane->interpolatedLongitude = newLongitude;
-        plane->interpolatedAltitude = newAltitude;
-        plane->pitch = newPitch;
+        selectedObjects[s] = AcquireModel(traffic.model[i]);
     }
-    pthread_mutex_unlock(&planesMutex);
+    proxyObject = AcquireProxyModel();
+    EndModelFrame(time);
+
+    // hand the nearest planes to X-Plane as multiplayer planes so that they show up on TCAS and are rendered by the sim
+    double userLatitude = XPLMGetDatad(latitudeDataRef), userLongitude = XPLMGetDatad(longitudeDataRef);
+    double userX = XPLMGetDatad(localXDataRef), userY = XPLMGetDatad(localYDataRef), userZ = XPLMGetDatad(localZDataRef);
+    UpdateMultiplayer(userLatitude, userLongitude, userX, userY, userZ);
 
-    return 0.01f;
+    // report further nearby planes to the cockpit traffic displays without rendering them as multiplayer planes
+    UpdateTcas(userLatitude, userLongitude, userX, userY, userZ);
+
+    // spend the rest of the frame budget on deferrable work
+    RunTasks(frameStart, frameBudget);
+
+    // run every frame, the deferrable work per frame is bounded by the frame budget
+    return -1.0f;
 }
 
 // draw-callback that performs the actual drawing of the planes
 static int DrawCallback(XPLMDrawingPhase inPhase, int inIsBefore, void *inRefcon)
 {
-    pthread_mutex_lock(&planesMutex);
-    for (std::map<std::string, Plane*>::iterator p = planes.begin(); p != planes.end(); ++p)
+    long long drawStart = LogEnabled(LOG_LEVEL_DEBUG) ? GetMicroseconds() : 0;
+
+    // X-Plane calls the callback several times per frame for shadows, reflections and additional views, the draw list is only built in the first pass of a frame and reused by the others, it is not rebuilt before the flight loop has caught up with a moved local coordinate system
+    int cycle = XPLMGetCycleNumber();
+    if (cycle != drawListCycle && !originShifted)
+    {
+        // group the selected planes that are visible from the camera by model so that every model is drawn with a single call
+        XPLMCameraPosition_t camera;
+        XPLMReadCameraPosition(&camera);
+        SetCullingCamera(&camera, XPLMGetDataf(fieldOfViewDataRef), XPLMGetDatai(windowWidthDataRef), XPLMGetDatai(windowHeightDataRef));
+        BuildDrawList(selectedObjects, proxyObject);
+
+        drawListCycle = cycle;
+    }
+
+    // the labels are projected with the matrices of the main view, the first pass of a frame may be a shadow or reflection pass, they are placed by a deferred task and drawn in the window phase
+    if (!showLabels)
+        ClearLabels();
+    else if (cycle != labelCycle && !originShifted && (worldRenderTypeDataRef == NULL || XPLMGetDatai(worldRenderTypeDataRef) == WORLD_RENDER_TYPE_NORMAL))
     {
-        /*char o[1024];
-        sprintf(o, "Rendering: %s\n", p->first.c_str());
-        XPLMDebugString(o);*/
-        Plane *plane = p->second;
-        double x = 0.0, y = 0.0, z = 0.0;
-        XPLMWorldToLocal(plane->interpolatedLatitude, plane->interpolatedLongitude, plane->interpolatedAltitude * FACTOR_FEET_TO_METERS, &x, &y, &z);
-
-        XPLMDrawInfo_t locations[1] = {0};
-        locations[0].structSize = sizeof(XPLMDrawInfo_t);
-        locations[0].x = (float) x;
-        locations[0].y = (float) y;
-        locations[0].z = (float) z;
-        locations[0].pitch = plane->roll; //TODO temp correction for obj orientation!
-        locations[0].heading = plane->heading + 90.0f; //TODO temp correction for obj orientation!
-        locations[0].roll = plane->pitch; //TODO temp correction for obj orientation!
-
-        if (object != NULL)
-            XPLMDrawObjects(object, 1, locations, 0, 1);
+        ProjectLabels();
+        labelCycle = cycle;
     }
-    pthread_mutex_unlock(&planesMutex);
 
+    for (int b = 0; b < drawBatchCount; b++)
+        XPLMDrawObjects(drawBatches[b].object, drawBatches[b].count, &drawInfos[drawBatches[b].first], 0, 1);
+
+    // distant planes are drawn as point sprites with a single call, depth tested against the scenery but without writing depth
+    if (impostorCount > 0)
+    {
+        XPLMSetGraphicsState(0, 0, 0, 0, 1, 1, 0);
+        glPointSize(IMPOSTOR_SIZE);
+        glColor4f(IMPOSTOR_COLOR);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, impostorVertices);
+        glDrawArrays(GL_POINTS, 0, impostorCount);
+        glDisableClientState(GL_VERTEX_ARRAY);
+    }
+
+    if (LogEnabled(LOG_LEVEL_DEBUG))
+    {
+        double values[] = {(double) (GetMicroseconds() - drawStart), (double) drawBatchCount, (double) selectedCount, (double) culledCount, (double) impostorCount};
+        LogValues(LOG_LEVEL_DEBUG, LOG_CATEGORY_GENERAL, "Draw Time = %.0f us, Batches = %.0f, Planes = %.0f, Culled = %.0f, Impostors = %.0f", NULL, 5, values);
+    }
+
+    return 1;
+}
+
+// draw-callback that draws the labels of the planes on top of the view
+static int LabelDrawCallback(XPLMDrawingPhase inPhase, int inIsBefore, void *inRefcon)
+{
+    if (showLabels)
+        DrawLabels();
 
     return 1;
 }
@@ -199,48 +410,135 @@ PLUGIN_API int XPluginStart(char *outName, char *outSig, char *outDesc)
     strcpy(outSig, "de.bwravencl." NAME_LOWERCASE);
     strcpy(outDesc, NAME " displays live air traffic from Flightradar24 in X-Plane!");
 
+    // start logging
+    char logPath[512];
+    XPLMGetSystemPath(logPath);
+    strncat(logPath, LOG_FILE, sizeof(logPath) - strlen(logPath) - 1);
+    LogInit(logPath);
+
+    // start the worker threads that take over the per-plane math
+    WorkersInit();
+
     // obtain datarefs
     latitudeDataRef = XPLMFindDataRef("sim/flightmodel/position/latitude");
     longitudeDataRef = XPLMFindDataRef("sim/flightmodel/position/longitude");
     elevationDataRef = XPLMFindDataRef("sim/flightmodel/position/elevation");
     earthRadiusMDataRef = XPLMFindDataRef("sim/physics/earth_radius_m");
-
-    // load object
-    object = XPLMLoadObject(OBJ_PATH);
-    if (object == NULL)
-        XPLMDebugString("Error: object not found!\n");
+    localXDataRef = XPLMFindDataRef("sim/flightmodel/position/local_x");
+    localYDataRef = XPLMFindDataRef("sim/flightmodel/position/local_y");
+    localZDataRef = XPLMFindDataRef("sim/flightmodel/position/local_z");
+    localVxDataRef = XPLMFindDataRef("sim/flightmodel/position/local_vx");
+    localVzDataRef = XPLMFindDataRef("sim/flightmodel/position/local_vz");
+    yAglDataRef = XPLMFindDataRef("sim/flightmodel/position/y_agl");
+    latRefDataRef = XPLMFindDataRef("sim/flightmodel/position/lat_ref");
+    lonRefDataRef = XPLMFindDataRef("sim/flightmodel/position/lon_ref");
+    fieldOfViewDataRef = XPLMFindDataRef("sim/graphics/view/field_of_view_deg");
+    windowWidthDataRef = XPLMFindDataRef("sim/graphics/view/window_width");
+    windowHeightDataRef = XPLMFindDataRef("sim/graphics/view/window_height");
+    worldRenderTypeDataRef = XPLMFindDataRef("sim/graphics/view/world_render_type");
+    latRef = XPLMGetDataf(latRefDataRef);
+    lonRef = XPLMGetDataf(lonRefDataRef);
+
+    // register datarefs
+    maxPlanesDataRef = XPLMRegisterDataAccessor(NAME_LOWERCASE "/max_planes", xplmType_Int, 1, GetMaxPlanesCallback, SetMaxPlanesCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    logLevelDataRef = XPLMRegisterDataAccessor(NAME_LOWERCASE "/log_level", xplmType_Int, 1, GetLogLevelCallback, SetLogLevelCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    terrainProbeBandDataRef = XPLMRegisterDataAccessor(NAME_LOWERCASE "/terrain_probe_band", xplmType_Float, 1, NULL, NULL, GetTerrainProbeBandCallback, SetTerrainProbeBandCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    frameBudgetDataRef = XPLMRegisterDataAccessor(NAME_LOWERCASE "/frame_budget", xplmType_Int, 1, GetFrameBudgetCallback, SetFrameBudgetCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    showLabelsDataRef = XPLMRegisterDataAccessor(NAME_LOWERCASE "/show_labels", xplmType_Int, 1, GetShowLabelsCallback, SetShowLabelsCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    showMapDataRef = XPLMRegisterDataAccessor(NAME_LOWERCASE "/show_map", xplmType_Int, 1, GetShowMapCallback, SetShowMapCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    modelLoadLatencyDataRef = XPLMRegisterDataAccessor(NAME_LOWERCASE "/model_load_latency", xplmType_Float, 0, NULL, NULL, GetModelLoadLatencyCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    modelCacheHitRateDataRef = XPLMRegisterDataAccessor(NAME_LOWERCASE "/model_cache_hit_rate", xplmType_Float, 0, NULL, NULL, GetModelCacheHitRateCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    culledPlanesDataRef = XPLMRegisterDataAccessor(NAME_LOWERCASE "/culled_planes", xplmType_Int, 0, GetCulledPlanesCallback, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+
+    // register deferrable work
+    RegisterTask(TASK_PRIORITY_HIGH, TerrainProbeTask, NULL);
+    RegisterTask(TASK_PRIORITY_NORMAL, ModelLoadTask, NULL);
+    RegisterTask(TASK_PRIORITY_LOW, ModelUnloadTask, NULL);
+    RegisterTask(TASK_PRIORITY_LOW, MultiplayerModelTask, NULL);
+    RegisterTask(TASK_PRIORITY_NORMAL, LabelLayoutTask, NULL);
+
+    // read the model mappings, the models themselves are loaded asynchronously once a plane needs them
+    char modelsPath[512];
+    XPLMGetSystemPath(modelsPath);
+    strncat(modelsPath, MODELS_FILE, sizeof(modelsPath) - strlen(modelsPath) - 1);
+    InitModels(modelsPath, OBJ_PATH);
+
+    InitMultiplayer();
+    InitTcas();
 
     Init();
 
     // register flight loop callbacks
     XPLMRegisterFlightLoopCallback(FlightLoopCallback, -1, NULL);
 
-    // register draw callback
+    // register draw callbacks
     XPLMRegisterDrawCallback(DrawCallback, xplm_Phase_Objects, 0, NULL);
+    XPLMRegisterDrawCallback(LabelDrawCallback, xplm_Phase_Window, 0, NULL);
+
+    // create the moving map window, it is shown through the show_map dataref
+    InitMap();
 
     return 1;
 }
 
 PLUGIN_API void	XPluginStop(void)
 {
-    if (probe != NULL)
-        XPLMDestroyProbe(probe);
+    XPLMUnregisterDataAccessor(maxPlanesDataRef);
+    XPLMUnregisterDataAccessor(logLevelDataRef);
+    XPLMUnregisterDataAccessor(terrainProbeBandDataRef);
+    XPLMUnregisterDataAccessor(frameBudgetDataRef);
+    XPLMUnregisterDataAccessor(showLabelsDataRef);
+    XPLMUnregisterDataAccessor(showMapDataRef);
+    XPLMUnregisterDataAccessor(modelLoadLatencyDataRef);
+    XPLMUnregisterDataAccessor(modelCacheHitRateDataRef);
+    XPLMUnregisterDataAccessor(culledPlanesDataRef);
+
+    ClearTasks();
+
+    CleanupMap();
+
+    ClearTerrainCache();
 
-    if (object != NULL)
-        XPLMUnloadObject(object);
+    ClearModels();
 
     Cleanup();
+
+    ClearTraffic();
+
+    WorkersCleanup();
+
+    LogCleanup();
 }
 
 PLUGIN_API void XPluginDisable(void)
 {
+    ReleaseTcas();
+    ReleaseMultiplayerPlanes();
 }
 
 PLUGIN_API int XPluginEnable(void)
 {
+    AcquireMultiplayerPlanes();
+
     return 1;
 }
 
 PLUGIN_API void XPluginReceiveMessage(XPLMPluginID inFromWho, long inMessage, void *inParam)
 {
+    if (inMessage == XPLM_MSG_SCENERY_LOADED)
+    {
+        ClearTerrainCache();
+
+        // X-Plane only moves the origin of the local coordinate system when it loads new scenery, the cached local coordinates are stale if it did
+        float newLatRef = XPLMGetDataf(latRefDataRef), newLonRef = XPLMGetDataf(lonRefDataRef);
+        if (newLatRef != latRef || newLonRef != lonRef)
+        {
+            latRef = newLatRef;
+            lonRef = newLonRef;
+            originShifted = true;
+            ClearDrawList();
+            ClearLabels();
+            LogString(LOG_LEVEL_INFO, LOG_CATEGORY_GENERAL, "Local coordinate system has moved");
+        }
+    }
 }